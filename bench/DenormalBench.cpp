@@ -0,0 +1,85 @@
+// DenormalBench.cpp - Render time as held voices decay to silence and are then
+// released, with and without DenormalGuard
+//
+// Sixteen notes with zero sustain and a one-second decay: once the envelopes reach
+// zero, the voices feed silence into their resonant filters, whose states ring down
+// into the denormal range. Without flush-to-zero the render time jumps there, a
+// little over a second in, and stays up while the notes are held; with the guard it
+// stays flat. The notes are released at RELEASE_TIME. Voices end when their release
+// falls below -60 dB and the engine goes idle once the effect tails are below
+// -100 dB, so nothing is left rendering in the denormal range after the release and
+// both columns drop to the idle cost.
+#include "DSP/FMEngine.h"
+#include "DSP/DenormalGuard.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const float SAMPLE_RATE = 48000.0f;
+const int BLOCK_SIZE = 256;
+const float SECONDS = 8.0f;
+const float RELEASE_TIME = 6.0f;   // seconds; the note-offs
+const float STEP = 0.25f;          // seconds per row of the timeline
+
+// Mean and worst block time for each STEP of rendering, in microseconds
+void run(bool guarded, std::vector<double>& mean, std::vector<double>& worst) {
+    auto engine = std::make_unique<FMEngine>();
+    engine->setSampleRate(SAMPLE_RATE);
+    for (int op = 0; op < FMEngine::NUM_OPERATORS; ++op) engine->setOperatorLevel(op, 0.5f);
+    engine->setAttack(0.001f);
+    engine->setDecay(1.0f);
+    engine->setSustain(0.0f);
+    engine->setRelease(0.3f);
+    engine->setFilterResonance(0.8f);
+    engine->setDelayTime(0.02f);
+    engine->setDelayFeedback(0.6f);
+    for (int note = 48; note < 64; ++note) engine->noteOn(note, 1.0f);
+
+    std::vector<float> left(BLOCK_SIZE), right(BLOCK_SIZE);
+    int blocksPerStep = static_cast<int>(STEP * SAMPLE_RATE) / BLOCK_SIZE;
+    int numSteps = static_cast<int>(SECONDS / STEP);
+    for (int step = 0; step < numSteps; ++step) {
+        if (step == static_cast<int>(RELEASE_TIME / STEP)) {
+            for (int note = 48; note < 64; ++note) engine->noteOff(note);
+        }
+        double total = 0.0, peak = 0.0;
+        for (int b = 0; b < blocksPerStep; ++b) {
+            auto start = std::chrono::steady_clock::now();
+            if (guarded) {
+                DenormalGuard denormalGuard;
+                engine->process(left.data(), right.data(), BLOCK_SIZE);
+            } else {
+                engine->process(left.data(), right.data(), BLOCK_SIZE);
+            }
+            double us = std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - start).count();
+            total += us;
+            peak = std::max(peak, us);
+        }
+        mean.push_back(total / blocksPerStep);
+        worst.push_back(peak);
+    }
+}
+
+}
+
+int main() {
+    std::vector<double> plainMean, plainWorst, guardMean, guardWorst;
+    run(false, plainMean, plainWorst);
+    run(true, guardMean, guardWorst);
+
+    std::printf("Block of %d samples at %.0f Hz, 16 voices decaying to silence, "
+                "released at %.2f s (microseconds)\n", BLOCK_SIZE, SAMPLE_RATE, RELEASE_TIME);
+    std::printf("hardware flush: %s\n\n", DenormalGuard::HARDWARE ? "yes" : "no (software)");
+    std::printf("%6s  %20s  %20s\n", "time", "no guard mean/worst", "guard mean/worst");
+    for (size_t i = 0; i < plainMean.size(); ++i) {
+        std::printf("%6.2f  %9.1f / %8.1f  %9.1f / %8.1f%s\n", i * STEP,
+                    plainMean[i], plainWorst[i], guardMean[i], guardWorst[i],
+                    (i == static_cast<size_t>(RELEASE_TIME / STEP)) ? "  <- release" : "");
+    }
+    return 0;
+}
@@ -0,0 +1,405 @@
+// DspBench.cpp - Nanoseconds per sample for the DSP building blocks and FMEngine
+//
+// Each component is timed in isolation, then the full engine across voice count,
+// algorithm, oversampling mode and block size. A result is the fastest of several
+// runs, which is the most repeatable figure on a busy machine.
+//
+//   DspBench [--filter TEXT] [--quick] [--json FILE] [--baseline FILE] [--tolerance F]
+//
+// With --baseline, each result is compared with the same name in a JSON file
+// written earlier by --json; anything slower by more than the tolerance (a
+// fraction, default 0.15) is reported and the exit status is 1.
+#include "DSP/FMEngine.h"
+#include "DSP/Operator.h"
+#include "DSP/Envelope.h"
+#include "DSP/Filter.h"
+#include "DSP/LFO.h"
+#include "DSP/StereoChorus.h"
+#include "DSP/StereoDelay.h"
+#include "DSP/Oversampler.h"
+#include "DSP/DenormalGuard.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+const float SAMPLE_RATE = 48000.0f;
+
+struct Settings {
+    std::string filter;
+    bool quick = false;
+    std::string jsonPath;
+    std::string baselinePath;
+    double tolerance = 0.15;
+};
+
+struct Result {
+    std::string name;
+    double nsPerSample;
+};
+
+// Keeps results observable so the optimizer cannot drop the work
+volatile float sink;
+
+using Body = std::function<void(int)>;
+
+// Fastest time per sample over several runs of body(numSamples)
+double measure(const Body& body, int numSamples, int runs) {
+    body(numSamples);   // warm up caches and branch predictors
+    double best = 1e30;
+    for (int r = 0; r < runs; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        body(numSamples);
+        double ns = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, ns / numSamples);
+    }
+    return best;
+}
+
+class Suite {
+public:
+    explicit Suite(const Settings& settings) : settings_(settings) {}
+
+    // Time the body returned by setup() unless the name is filtered out. Setup is
+    // not timed; state it creates carries over between runs. numSamples is per run.
+    void add(const std::string& name, int numSamples, const std::function<Body()>& setup) {
+        if (!settings_.filter.empty() && name.find(settings_.filter) == std::string::npos) return;
+        int samples = settings_.quick ? std::max(1, numSamples / 4) : numSamples;
+        double ns = measure(setup(), samples, settings_.quick ? 3 : 7);
+        results_.push_back({ name, ns });
+        std::printf("%-40s %10.2f ns/sample\n", name.c_str(), ns);
+        std::fflush(stdout);
+    }
+
+    bool quick() const { return settings_.quick; }
+    const std::vector<Result>& results() const { return results_; }
+
+private:
+    const Settings& settings_;
+    std::vector<Result> results_;
+};
+
+void componentBenchmarks(Suite& suite) {
+    const int N = 1 << 16;
+
+    suite.add("operator", N, [] {
+        auto op = std::make_shared<Operator>();
+        op->setFeedback(0.3f);
+        op->setFrequency(440.0f, SAMPLE_RATE);
+        return [op](int n) {
+            float sum = 0.0f;
+            for (int i = 0; i < n; ++i) {
+                op->setModulatorInput(sum * 0.001f);
+                op->process();
+                sum += op->getOutput();
+            }
+            sink = sum;
+        };
+    });
+
+    // Attack, decay and sustain, then release, in every run
+    suite.add("envelope", N, [] {
+        auto env = std::make_shared<Envelope>();
+        env->setSampleRate(SAMPLE_RATE);
+        env->setAttack(0.01f);
+        env->setDecay(0.2f);
+        env->setSustain(0.5f);
+        env->updateCoefs();
+        return [env](int n) {
+            env->trigger();
+            float sum = 0.0f;
+            for (int i = 0; i < n; ++i) {
+                if (i == n / 2) env->release();
+                env->process();
+                sum += env->getLevel();
+            }
+            sink = sum;
+        };
+    });
+
+    // Fixed cutoff, and cutoff ramped every control interval as under modulation
+    const char* topologies[] = { "biquad", "svf" };
+    for (int topology = 0; topology < 2; ++topology) {
+        for (bool ramp : { false, true }) {
+            std::string name = std::string("filter.") + topologies[topology] + (ramp ? ".ramp" : "");
+            suite.add(name, N, [topology, ramp] {
+                auto filter = std::make_shared<Filter>();
+                filter->setSampleRate(SAMPLE_RATE);
+                filter->setTopology(topology);
+                filter->setCutoff(2000.0f);
+                filter->setResonance(0.5f);
+                filter->updateCoefs();
+                return [filter, ramp](int n) {
+                    const int interval = FMEngine::DEFAULT_CONTROL_INTERVAL;
+                    float sum = 0.0f, x = 0.5f;
+                    for (int i = 0; i < n; ++i) {
+                        if (ramp && i % interval == 0) filter->rampCutoff(1000.0f + (i & 4095), interval);
+                        x = -x;
+                        filter->process(x);
+                        sum += filter->getOutput();
+                    }
+                    sink = sum;
+                };
+            });
+        }
+    }
+
+    const char* waves[] = { "sine", "saw", "square", "triangle" };
+    for (int wave = 0; wave < 4; ++wave) {
+        suite.add(std::string("lfo.") + waves[wave], N, [wave] {
+            auto lfo = std::make_shared<LFO>();
+            lfo->setSampleRate(SAMPLE_RATE);
+            lfo->setRate(5.0f);
+            lfo->setDepth(1.0f);
+            lfo->setWave(wave);
+            return [lfo](int n) {
+                float sum = 0.0f;
+                for (int i = 0; i < n; ++i) {
+                    lfo->process();
+                    sum += lfo->getOutput();
+                }
+                sink = sum;
+            };
+        });
+    }
+
+    // Effects run on blocks; 256 is a typical host block
+    const int BLOCK = 256;
+    suite.add("chorus", N, [] {
+        auto chorus = std::make_shared<StereoChorus>();
+        chorus->setSampleRate(SAMPLE_RATE);
+        chorus->setDepth(0.5f);
+        return [chorus](int n) {
+            float in[BLOCK], left[BLOCK], right[BLOCK];
+            for (int s = 0; s < BLOCK; ++s) in[s] = (s & 1) ? 0.25f : -0.25f;
+            for (int pos = 0; pos < n; pos += BLOCK) chorus->processBlock(in, left, right, BLOCK);
+            sink = left[0] + right[0];
+        };
+    });
+
+    suite.add("delay", N, [] {
+        auto delay = std::make_shared<StereoDelay>();
+        delay->setSampleRate(SAMPLE_RATE);
+        delay->setTime(0.25f);
+        delay->setFeedback(0.5f);
+        return [delay](int n) {
+            float in[BLOCK], left[BLOCK], right[BLOCK];
+            for (int s = 0; s < BLOCK; ++s) in[s] = (s & 1) ? 0.25f : -0.25f;
+            for (int pos = 0; pos < n; pos += BLOCK) delay->processBlock(in, left, right, BLOCK);
+            sink = left[0] + right[0];
+        };
+    });
+
+    // Per output sample; the buses are refilled before each call, as the voices do
+    struct Config { const char* name; OversampleMode mode; OversampleFilter filter; };
+    const Config configs[] = {
+        { "oversampler.x2.fir", OversampleMode::x2, OversampleFilter::FIR },
+        { "oversampler.x2.iir", OversampleMode::x2, OversampleFilter::IIR },
+        { "oversampler.x4.fir", OversampleMode::x4, OversampleFilter::FIR },
+        { "oversampler.x4.iir", OversampleMode::x4, OversampleFilter::IIR },
+        { "oversampler.auto.fir", OversampleMode::Auto, OversampleFilter::FIR },
+        { "oversampler.auto.iir", OversampleMode::Auto, OversampleFilter::IIR },
+    };
+    for (const Config& config : configs) {
+        suite.add(config.name, N, [config] {
+            auto oversampler = std::make_shared<Oversampler>();
+            oversampler->setFilter(config.filter);
+            oversampler->setMode(config.mode);
+            return [oversampler](int n) {
+                const int out = Oversampler::MAX_OUTPUT / 2;
+                alignas(64) float buses[Oversampler::NUM_BUSES][4 * out];
+                float* bus[Oversampler::NUM_BUSES] = { buses[0], buses[1], buses[2] };
+                for (int pos = 0; pos < n; pos += out) {
+                    for (int b = 0; b < Oversampler::NUM_BUSES; ++b) {
+                        for (int s = 0; s < (out << b); ++s) buses[b][s] = (s & 1) ? 0.25f : -0.25f;
+                    }
+                    oversampler->mixDown(bus, out);
+                }
+                sink = buses[0][0];
+            };
+        });
+    }
+}
+
+struct EngineScenario {
+    int voices;
+    int algorithm;     // 1-8
+    OversampleMode oversample;
+    int blockSize;
+};
+
+const char* oversampleName(OversampleMode mode) {
+    switch (mode) {
+        case OversampleMode::x2: return "x2";
+        case OversampleMode::x4: return "x4";
+        case OversampleMode::Auto: return "auto";
+        default: return "off";
+    }
+}
+
+// Held notes at full sustain, so every run renders the same steady load
+void engineBenchmark(Suite& suite, const EngineScenario& scenario) {
+    char name[96];
+    std::snprintf(name, sizeof(name), "engine.v%d.a%d.%s.b%d", scenario.voices, scenario.algorithm,
+                  oversampleName(scenario.oversample), scenario.blockSize);
+    suite.add(name, 1 << 15, [scenario] {
+        auto engine = std::make_shared<FMEngine>();
+        engine->setSampleRate(SAMPLE_RATE);
+        engine->setPolyphony(std::max(scenario.voices, FMEngine::DEFAULT_POLYPHONY));
+        engine->setAlgorithm(scenario.algorithm - 1);
+        for (int op = 0; op < FMEngine::NUM_OPERATORS; ++op) {
+            engine->setOperatorRatio(op, 1.0f + op);
+            engine->setOperatorLevel(op, 0.5f);
+        }
+        engine->setSustain(1.0f);
+        engine->setLFODepth(0, 0.2f);
+        engine->setOversampling(scenario.oversample);
+        for (int v = 0; v < scenario.voices; ++v) engine->noteOn(36 + (v * 7) % 60, 0.8f);
+
+        auto left = std::make_shared<std::vector<float>>(scenario.blockSize);
+        auto right = std::make_shared<std::vector<float>>(scenario.blockSize);
+        return [engine, left, right, blockSize = scenario.blockSize](int n) {
+            for (int pos = 0; pos < n; pos += blockSize) {
+                engine->process(left->data(), right->data(), blockSize);
+            }
+            sink = (*left)[0];
+        };
+    });
+}
+
+void engineBenchmarks(Suite& suite) {
+    const int defaultBlock = 256;
+    std::vector<int> voiceCounts = { 1, 4, 8, 16, 32 };
+    if (suite.quick()) voiceCounts = { 1, 16 };
+
+    // Voice count by algorithm
+    for (int voices : voiceCounts) {
+        for (int algorithm = 1; algorithm <= FMEngine::NUM_ALGORITHMS; ++algorithm) {
+            engineBenchmark(suite, { voices, algorithm, OversampleMode::Off, defaultBlock });
+        }
+    }
+    // Oversampling modes
+    for (int voices : { 1, 16 }) {
+        for (OversampleMode mode : { OversampleMode::x2, OversampleMode::x4, OversampleMode::Auto }) {
+            engineBenchmark(suite, { voices, 1, mode, defaultBlock });
+        }
+    }
+    // Host block sizes
+    for (int blockSize : { 32, 64, 128, 512, 1024 }) {
+        engineBenchmark(suite, { 8, 1, OversampleMode::Off, blockSize });
+    }
+}
+
+bool writeJson(const std::string& path, const std::vector<Result>& results) {
+    std::ofstream file(path);
+    if (!file) return false;
+    file << "{\n  \"unit\": \"ns/sample\",\n  \"results\": {\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        char value[32];
+        std::snprintf(value, sizeof(value), "%.3f", results[i].nsPerSample);
+        file << "    \"" << results[i].name << "\": " << value << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    file << "  }\n}\n";
+    return true;
+}
+
+// Reads the "name": value pairs of a file written by writeJson
+bool readJson(const std::string& path, std::map<std::string, double>& values) {
+    std::ifstream file(path);
+    if (!file) return false;
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t open = line.find('"');
+        size_t close = (open == std::string::npos) ? open : line.find('"', open + 1);
+        size_t colon = (close == std::string::npos) ? close : line.find(':', close);
+        if (colon == std::string::npos) continue;
+        char* end = nullptr;
+        double value = std::strtod(line.c_str() + colon + 1, &end);
+        if (end != line.c_str() + colon + 1) values[line.substr(open + 1, close - open - 1)] = value;
+    }
+    return true;
+}
+
+// Number of results slower than the baseline by more than the tolerance
+int compare(const std::vector<Result>& results, const std::map<std::string, double>& baseline,
+            double tolerance) {
+    int regressions = 0;
+    std::printf("\n%-40s %10s %10s %8s\n", "benchmark", "baseline", "now", "change");
+    for (const Result& result : results) {
+        auto it = baseline.find(result.name);
+        if (it == baseline.end() || it->second <= 0.0) {
+            std::printf("%-40s %10s %10.2f %8s\n", result.name.c_str(), "-", result.nsPerSample, "new");
+            continue;
+        }
+        double change = result.nsPerSample / it->second - 1.0;
+        const char* verdict = "";
+        if (change > tolerance) {
+            verdict = "  REGRESSION";
+            ++regressions;
+        } else if (change < -tolerance) {
+            verdict = "  faster";
+        }
+        std::printf("%-40s %10.2f %10.2f %+7.1f%%%s\n", result.name.c_str(), it->second,
+                    result.nsPerSample, change * 100.0, verdict);
+    }
+    return regressions;
+}
+
+void usage() {
+    std::fprintf(stderr,
+        "usage: DspBench [--filter TEXT] [--quick] [--json FILE] [--baseline FILE] [--tolerance F]\n");
+}
+
+}
+
+int main(int argc, char** argv) {
+    Settings settings;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (arg == "--quick") {
+            settings.quick = true;
+        } else if (value && arg == "--filter") {
+            settings.filter = argv[++i];
+        } else if (value && arg == "--json") {
+            settings.jsonPath = argv[++i];
+        } else if (value && arg == "--baseline") {
+            settings.baselinePath = argv[++i];
+        } else if (value && arg == "--tolerance") {
+            settings.tolerance = std::strtod(argv[++i], nullptr);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    DenormalGuard denormalGuard;
+    Suite suite(settings);
+    componentBenchmarks(suite);
+    engineBenchmarks(suite);
+
+    if (!settings.jsonPath.empty() && !writeJson(settings.jsonPath, suite.results())) {
+        std::fprintf(stderr, "cannot write %s\n", settings.jsonPath.c_str());
+        return 2;
+    }
+    if (!settings.baselinePath.empty()) {
+        std::map<std::string, double> baseline;
+        if (!readJson(settings.baselinePath, baseline)) {
+            std::fprintf(stderr, "cannot read %s\n", settings.baselinePath.c_str());
+            return 2;
+        }
+        int regressions = compare(suite.results(), baseline, settings.tolerance);
+        std::printf("\n%d regression(s) beyond %.0f%%\n", regressions, settings.tolerance * 100.0);
+        return (regressions > 0) ? 1 : 0;
+    }
+    return 0;
+}
@@ -0,0 +1,271 @@
+// StressBench.cpp - Worst-case block render time under adversarial event streams
+//
+// Average throughput hides the block that misses the deadline. Each scenario is
+// rendered block by block with its events and parameter changes applied inside the
+// block, and the time of every block, events included, is recorded. The report
+// gives p50/p99/p99.9/max against the real-time budget (block size / sample rate)
+// and counts the overruns.
+//
+//   StressBench [--seconds S] [--threads N] [--oversample off|2x|4x|auto] [--filter TEXT]
+#include "DSP/FMEngine.h"
+#include "DSP/DenormalGuard.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+const float SAMPLE_RATE = 48000.0f;
+const int BLOCK_SIZES[] = { 64, 128, 256 };
+
+struct Settings {
+    float seconds = 10.0f;
+    int threads = 0;
+    OversampleMode oversample = OversampleMode::Off;
+    std::string filter;
+};
+
+// Renders one block into left/right, applying its own events
+using BlockRenderer = std::function<void(FMEngine&, float*, float*, int blockSize, int64_t block)>;
+
+struct Scenario {
+    const char* name;
+    const char* description;
+    BlockRenderer render;
+};
+
+// A preset unlike the defaults in every field, for program changes
+EngineState otherPreset() {
+    EngineState state;
+    for (int op = 0; op < EngineState::NUM_OPERATORS; ++op) {
+        state.operators[op] = { 1.0f + op * 1.5f, 0.8f - op * 0.1f, (op == 0) ? 0.3f : 0.0f };
+    }
+    state.algorithm = 5;
+    state.filterType = 1;
+    state.filterCutoff = 3000.0f;
+    state.filterResonance = 0.6f;
+    state.attack = 0.2f;
+    state.decay = 0.8f;
+    state.sustain = 0.4f;
+    state.release = 1.5f;
+    state.lfos[0] = { 5.0f, 0.3f, 1 };
+    state.lfos[1] = { 0.5f, 0.5f, 2 };
+    state.chorusRate = 0.4f;
+    state.chorusDepth = 0.6f;
+    state.delayTime = 0.4f;
+    state.delayFeedback = 0.5f;
+    state.masterVolume = 0.6f;
+    return state;
+}
+
+std::vector<Scenario> scenarios() {
+    auto rng = std::make_shared<std::mt19937>(1234);
+
+    return {
+        { "steady", "16 held notes, no events",
+          [](FMEngine& engine, float* left, float* right, int n, int64_t) {
+              engine.process(left, right, n);
+          } },
+
+        // 1000 note-ons in one block every quarter second, each at its own sample,
+        // released a block later: nearly all of them steal a voice
+        { "cluster", "1000-note clusters (voice stealing)",
+          [rng](FMEngine& engine, float* left, float* right, int n, int64_t block) {
+              int period = std::max<int>(1, static_cast<int>(0.25f * SAMPLE_RATE) / n);
+              if (block % period == 0) {
+                  const int notes = 1000;
+                  int pos = 0;
+                  for (int i = 0; i < notes; ++i) {
+                      int at = static_cast<int>(static_cast<int64_t>(i) * n / notes);
+                      if (at > pos) {
+                          engine.process(left + pos, right + pos, at - pos);
+                          pos = at;
+                      }
+                      engine.noteOn(24 + (*rng)() % 84, 0.5f + ((*rng)() % 64) / 127.0f);
+                  }
+                  engine.process(left + pos, right + pos, n - pos);
+              } else {
+                  if (block % period == 1) {
+                      for (int note = 0; note < 128; ++note) engine.noteOff(note);
+                  }
+                  engine.process(left, right, n);
+              }
+          } },
+
+        // Every playing note struck again at the start of every block
+        { "retrigger", "all-voice retrigger every block",
+          [](FMEngine& engine, float* left, float* right, int n, int64_t) {
+              for (int v = 0; v < FMEngine::DEFAULT_POLYPHONY; ++v) engine.noteOn(36 + v * 3, 0.8f);
+              engine.process(left, right, n);
+          } },
+
+        // Sample-accurate automation: a new cutoff at every sample
+        { "cutoff-sweep", "filter cutoff change every sample",
+          [](FMEngine& engine, float* left, float* right, int n, int64_t block) {
+              for (int s = 0; s < n; ++s) {
+                  float phase = static_cast<float>((block * n + s) % 48000) / 48000.0f;
+                  engine.setFilterCutoff(200.0f + 15000.0f * phase);
+                  engine.process(left + s, right + s, 1);
+              }
+          } },
+
+        // Cutoff, resonance and every operator level and ratio at every sample
+        { "param-sweep", "cutoff, resonance, operator level and ratio every sample",
+          [](FMEngine& engine, float* left, float* right, int n, int64_t block) {
+              for (int s = 0; s < n; ++s) {
+                  float phase = static_cast<float>((block * n + s) % 48000) / 48000.0f;
+                  engine.setFilterCutoff(200.0f + 15000.0f * phase);
+                  engine.setFilterResonance(phase * 0.9f);
+                  for (int op = 0; op < FMEngine::NUM_OPERATORS; ++op) {
+                      engine.setOperatorLevel(op, 0.2f + 0.6f * phase);
+                      engine.setOperatorRatio(op, 1.0f + op + phase);
+                  }
+                  engine.process(left + s, right + s, 1);
+              }
+          } },
+
+        // Host automation of all four envelope stages at 8 points per block, applied
+        // the way the plugin does: the render is split only at the control update
+        // after a point, where every change since the last update is applied at once
+        { "adsr-sweep", "attack, decay, sustain and release at 8 points per block",
+          [](FMEngine& engine, float* left, float* right, int n, int64_t block) {
+              const int points = 8;
+              int next = 0;
+              for (int pos = 0; pos < n;) {
+                  for (; next < points && next * n / points <= pos; ++next) {
+                      int64_t at = block * n + next * n / points;
+                      float phase = static_cast<float>(at % 48000) / 48000.0f;
+                      engine.setAttack(0.005f + 0.1f * phase);
+                      engine.setDecay(0.05f + 0.5f * phase);
+                      engine.setSustain(0.3f + 0.5f * phase);
+                      engine.setRelease(0.1f + phase);
+                  }
+                  int end = n;
+                  if (next < points) {
+                      end = std::min(n, pos + engine.nextControlUpdate(next * n / points - pos));
+                  }
+                  engine.process(left + pos, right + pos, end - pos);
+                  pos = end;
+              }
+          } },
+
+        // Alternating between two whole presets at the start of every block
+        { "program-change", "preset snapshot swapped in every block",
+          [](FMEngine& engine, float* left, float* right, int n, int64_t block) {
+              static const EngineState presets[2] = { EngineState(), otherPreset() };
+              engine.applyState(presets[block & 1]);
+              engine.process(left, right, n);
+          } },
+    };
+}
+
+struct Stats {
+    double p50, p99, p999, max;   // microseconds
+    int overruns;
+};
+
+double percentile(const std::vector<double>& sorted, double p) {
+    size_t index = static_cast<size_t>(p * sorted.size());
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+Stats run(const Scenario& scenario, const Settings& settings, int blockSize) {
+    auto engine = std::make_unique<FMEngine>();
+    engine->setSampleRate(SAMPLE_RATE);
+    engine->setRenderThreads(settings.threads);
+    for (int op = 0; op < FMEngine::NUM_OPERATORS; ++op) {
+        engine->setOperatorRatio(op, 1.0f + op);
+        engine->setOperatorLevel(op, 0.5f);
+    }
+    engine->setSustain(0.8f);
+    engine->setOversampling(settings.oversample);
+    for (int v = 0; v < FMEngine::DEFAULT_POLYPHONY; ++v) engine->noteOn(36 + v * 3, 0.8f);
+
+    std::vector<float> left(blockSize), right(blockSize);
+    int64_t numBlocks = static_cast<int64_t>(settings.seconds * SAMPLE_RATE) / blockSize;
+    double budget = 1e6 * blockSize / SAMPLE_RATE;
+    std::vector<double> times;
+    times.reserve(numBlocks);
+
+    for (int64_t block = 0; block < numBlocks; ++block) {
+        auto start = std::chrono::steady_clock::now();
+        scenario.render(*engine, left.data(), right.data(), blockSize, block);
+        times.push_back(std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+
+    Stats stats = {};
+    stats.overruns = static_cast<int>(std::count_if(times.begin(), times.end(),
+                                                     [budget](double t) { return t > budget; }));
+    std::sort(times.begin(), times.end());
+    stats.p50 = percentile(times, 0.5);
+    stats.p99 = percentile(times, 0.99);
+    stats.p999 = percentile(times, 0.999);
+    stats.max = times.back();
+    return stats;
+}
+
+void usage() {
+    std::fprintf(stderr,
+        "usage: StressBench [--seconds S] [--threads N] [--oversample off|2x|4x|auto] [--filter TEXT]\n");
+}
+
+}
+
+int main(int argc, char** argv) {
+    Settings settings;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (arg == "--seconds") settings.seconds = std::strtof(value.c_str(), nullptr);
+        else if (arg == "--threads") settings.threads = std::atoi(value.c_str());
+        else if (arg == "--filter") settings.filter = value;
+        else if (arg == "--oversample") {
+            if (value == "off") settings.oversample = OversampleMode::Off;
+            else if (value == "2x") settings.oversample = OversampleMode::x2;
+            else if (value == "4x") settings.oversample = OversampleMode::x4;
+            else if (value == "auto") settings.oversample = OversampleMode::Auto;
+            else {
+                usage();
+                return 2;
+            }
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    DenormalGuard denormalGuard;
+    std::printf("%.0f Hz, %.0f s per run, %d render thread(s); block times in microseconds\n",
+                SAMPLE_RATE, settings.seconds, settings.threads);
+    for (const Scenario& scenario : scenarios()) {
+        std::printf("  %-14s %s\n", scenario.name, scenario.description);
+    }
+    std::printf("\n%-14s %5s %8s %8s %8s %8s %8s %8s %9s\n", "scenario", "block", "budget",
+                "p50", "p99", "p99.9", "max", "max/bud", "overruns");
+
+    for (const Scenario& scenario : scenarios()) {
+        if (!settings.filter.empty() && std::string(scenario.name).find(settings.filter) == std::string::npos) {
+            continue;
+        }
+        for (int blockSize : BLOCK_SIZES) {
+            Stats stats = run(scenario, settings, blockSize);
+            double budget = 1e6 * blockSize / SAMPLE_RATE;
+            std::printf("%-14s %5d %8.1f %8.1f %8.1f %8.1f %8.1f %7.0f%% %9d\n", scenario.name,
+                        blockSize, budget, stats.p50, stats.p99, stats.p999, stats.max,
+                        100.0 * stats.max / budget, stats.overruns);
+            std::fflush(stdout);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+#ifndef ALGORITHMS_H
+#define ALGORITHMS_H
+
+#include <utility>
+#include <type_traits>
+
+// Each algorithm defines: which operators modulate which, and which are carriers (go to output).
+// Operators are processed in the order specified by processOrder so modulators run before carriers.
+struct AlgorithmDef {
+    // For each operator, list of operator indices that modulate it (phase mod sources)
+    int modulators[6][6]; // modulators[op][i] = source op index, -1 = end
+    // Which operators are carriers (contribute to audio output)
+    bool isCarrier[6];
+    // Processing order: modulators first, then carriers
+    int processOrder[6];
+};
+
+// 8 algorithms matching the spec:
+// 1: 1>2>3>4>5>6 (serial chain, op6 is carrier)
+// 2: (1+2)>3>4>5>6 (ops 1,2 parallel into 3, chain to 6)
+// 3: 1>(2+3+4+5+6) (op1 modulates all, ops 2-6 are carriers)
+// 4: ((1+2)+(3+4))>5>6 (two pairs summed, chain to 6)
+// 5: 1>2, 3>4, 5>6 (3 parallel pairs; ops 2,4,6 are carriers)
+// 6: (1+2+3)>(4+5+6) (group 1-3 mods group 4-6; ops 4,5,6 are carriers)
+// 7: 1>2>3, 4>5>6 (2 parallel chains; ops 3,6 are carriers)
+// 8: All summed to output (no modulation, all carriers)
+static constexpr AlgorithmDef kAlgorithms[8] = {
+    // Algo 1: 1>2>3>4>5>6 (serial). Carrier: 6 only.
+    // Op0 has no mod. Op1 modulated by op0. Op2 by op1. Op3 by op2. Op4 by op3. Op5 by op4.
+    {
+        {{-1},{0,-1},{1,-1},{2,-1},{3,-1},{4,-1}},
+        {false, false, false, false, false, true},
+        {0, 1, 2, 3, 4, 5}
+    },
+    // Algo 2: (1+2)>3>4>5>6. Carriers: 6.
+    // Op2 modulated by op0+op1. Op3 by op2. Op4 by op3. Op5 by op4.
+    {
+        {{-1},{-1},{0,1,-1},{2,-1},{3,-1},{4,-1}},
+        {false, false, false, false, false, true},
+        {0, 1, 2, 3, 4, 5}
+    },
+    // Algo 3: 1>(2+3+4+5+6). Op0 modulates ops 1-5. Carriers: 1,2,3,4,5.
+    {
+        {{-1},{0,-1},{0,-1},{0,-1},{0,-1},{0,-1}},
+        {false, true, true, true, true, true},
+        {0, 1, 2, 3, 4, 5}
+    },
+    // Algo 4: ((1+2)+(3+4))>5>6. Carriers: 6.
+    // Op4 modulated by op0+op1+op2+op3. Op5 by op4.
+    {
+        {{-1},{-1},{-1},{-1},{0,1,2,3,-1},{4,-1}},
+        {false, false, false, false, false, true},
+        {0, 1, 2, 3, 4, 5}
+    },
+    // Algo 5: 1>2, 3>4, 5>6 (3 parallel pairs). Carriers: 2,4,6 (indices 1,3,5).
+    {
+        {{-1},{0,-1},{-1},{2,-1},{-1},{4,-1}},
+        {false, true, false, true, false, true},
+        {0, 1, 2, 3, 4, 5}
+    },
+    // Algo 6: (1+2+3)>(4+5+6). Ops 0,1,2 modulate ops 3,4,5. Carriers: 4,5,6 (indices 3,4,5).
+    {
+        {{-1},{-1},{-1},{0,1,2,-1},{0,1,2,-1},{0,1,2,-1}},
+        {false, false, false, true, true, true},
+        {0, 1, 2, 3, 4, 5}
+    },
+    // Algo 7: 1>2>3, 4>5>6 (2 parallel chains). Carriers: 3,6 (indices 2,5).
+    {
+        {{-1},{0,-1},{1,-1},{-1},{3,-1},{4,-1}},
+        {false, false, true, false, false, true},
+        {0, 1, 2, 3, 4, 5}
+    },
+    // Algo 8: All summed to output (no modulation). All carriers.
+    {
+        {{-1},{-1},{-1},{-1},{-1},{-1}},
+        {true, true, true, true, true, true},
+        {0, 1, 2, 3, 4, 5}
+    }
+};
+
+
+// Compile-time queries on kAlgorithms, used to generate one straight-line kernel per
+// algorithm instead of walking the tables every sample.
+static constexpr int algorithmModulatorCount(int algo, int op) {
+    int n = 0;
+    while (n < 6 && kAlgorithms[algo].modulators[op][n] >= 0) n++;
+    return n;
+}
+
+static constexpr int algorithmCarrierCount(int algo) {
+    int n = 0;
+    for (int op = 0; op < 6; ++op) {
+        if (kAlgorithms[algo].isCarrier[op]) n++;
+    }
+    return n;
+}
+
+static constexpr int algorithmFirstCarrier(int algo) {
+    int op = 0;
+    while (op < 5 && !kAlgorithms[algo].isCarrier[op]) op++;
+    return op;
+}
+
+// 1/sqrt(numCarriers): keeps the output level consistent across algorithms
+static constexpr float kCarrierGain[7] = {
+    1.0f, 1.0f, 0.70710678f, 0.57735027f, 0.5f, 0.44721360f, 0.40824829f
+};
+
+// Calls f(std::integral_constant<int, I>{}) for I = 0..N-1, fully unrolled
+template<int N, typename F>
+inline void staticFor(F&& f) {
+    [&]<int... I>(std::integer_sequence<int, I...>) {
+        (f(std::integral_constant<int, I>{}), ...);
+    }(std::make_integer_sequence<int, N>{});
+}
+
+// Evaluate algorithm A for one sample. processOp(op, modInput) advances operator op
+// (an std::integral_constant) with the given phase modulation in radians and returns
+// its output. T is float for the scalar path or SimdFloat for the voice bank; zero
+// is T's zero value. Returns the normalized carrier sum.
+template<int A, typename T, typename ProcessOp>
+inline T evaluateAlgorithm(ProcessOp&& processOp, T zero) {
+    T opOutput[6];
+
+    staticFor<6>([&](auto idx) {
+        constexpr int op = kAlgorithms[A].processOrder[idx];
+        constexpr int numMods = algorithmModulatorCount(A, op);
+
+        T modInput = zero;
+        if constexpr (numMods > 0) {
+            T sum = opOutput[kAlgorithms[A].modulators[op][0]];
+            staticFor<numMods - 1>([&](auto m) {
+                sum = sum + opOutput[kAlgorithms[A].modulators[op][m + 1]];
+            });
+            modInput = sum * 5.0f;
+        }
+        opOutput[op] = processOp(std::integral_constant<int, op>{}, modInput);
+    });
+
+    constexpr int firstCarrier = algorithmFirstCarrier(A);
+    T carrierSum = opOutput[firstCarrier];
+    staticFor<6>([&](auto op) {
+        if constexpr (op > firstCarrier && kAlgorithms[A].isCarrier[op]) {
+            carrierSum = carrierSum + opOutput[op];
+        }
+    });
+
+    constexpr int numCarriers = algorithmCarrierCount(A);
+    if constexpr (numCarriers > 1) {
+        carrierSum = carrierSum * kCarrierGain[numCarriers];
+    }
+    return carrierSum;
+}
+
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+// Prewarped filter gain K = tan(pi * fc / fs) by table lookup.
+//
+// The table is indexed by log-frequency without calling log2: the exponent and top
+// SEGMENT_BITS of mantissa of the normalized cutoff fc / fs (a float) select one of 64
+// segments per octave, and the remaining mantissa bits interpolate linearly. Because
+// the input is normalized, one table serves every sample rate. It spans 2^-17 up to
+// 0.49 of the sample rate (20 Hz at 2.6 MHz up to just below Nyquist); the worst-case
+// interpolation error, at the top of the range, is 1.2 cents of cutoff.
+class CutoffTable {
+public:
+    static const int SEGMENT_BITS = 6;
+    static const int MIN_OCTAVE = -17;
+    static const int NUM_OCTAVES = 16;
+    static const int TABLE_SIZE = NUM_OCTAVES << SEGMENT_BITS;
+    static constexpr float MIN_NORMALIZED = 1.0f / (1 << -MIN_OCTAVE);
+    static constexpr float MAX_NORMALIZED = 0.49f;
+
+    static inline float lookup(float normalizedCutoff) {
+        if (normalizedCutoff < MIN_NORMALIZED) normalizedCutoff = MIN_NORMALIZED;
+        if (normalizedCutoff > MAX_NORMALIZED) normalizedCutoff = MAX_NORMALIZED;
+
+        const float* t = values_.data;
+        uint32_t bits = std::bit_cast<uint32_t>(normalizedCutoff);
+        uint32_t index = (bits >> FRAC_BITS) - FIRST_KEY;
+        float frac = static_cast<float>(bits & FRAC_MASK) * (1.0f / (1 << FRAC_BITS));
+        return t[index] + (t[index + 1] - t[index]) * frac;
+    }
+
+private:
+    static const int FRAC_BITS = 23 - SEGMENT_BITS;
+    static const uint32_t FRAC_MASK = (1u << FRAC_BITS) - 1;
+    // Exponent/segment key of MIN_NORMALIZED
+    static const uint32_t FIRST_KEY = static_cast<uint32_t>(127 + MIN_OCTAVE) << SEGMENT_BITS;
+
+    struct Values {
+        Values() {
+            for (int i = 0; i <= TABLE_SIZE; ++i) {
+                int octave = MIN_OCTAVE + (i >> SEGMENT_BITS);
+                double mantissa = 1.0 + static_cast<double>(i & ((1 << SEGMENT_BITS) - 1)) /
+                                            (1 << SEGMENT_BITS);
+                double f = std::ldexp(mantissa, octave);
+                data[i] = static_cast<float>(std::tan(3.141592653589793 * std::fmin(f, 0.4999)));
+            }
+        }
+        // One guard entry so index + 1 never needs bounds checking
+        alignas(64) float data[TABLE_SIZE + 1];
+    };
+
+    static inline const Values values_;
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+// Flush-to-zero for the current thread while in scope. Denormal floats (below about
+// 1e-38) take a slow path on most CPUs; filter states and feedback loops decaying
+// toward zero reach them and can cost many times the normal render time.
+//
+// Sets FTZ and DAZ in MXCSR on x86, FZ in FPCR/FPSCR on ARM, and restores the
+// previous mode on exit. Where neither is available, HARDWARE is false and the
+// feedback paths call flushDenormal() to do it in software instead.
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <immintrin.h>
+#define FMG_DENORMALS_X86 1
+#elif defined(_M_ARM64)
+#include <intrin.h>
+#define FMG_DENORMALS_ARM64_MSVC 1
+#elif defined(__aarch64__)
+#define FMG_DENORMALS_ARM64 1
+#elif defined(__arm__) && defined(__ARM_FP)
+#define FMG_DENORMALS_ARM32 1
+#endif
+
+#include <cmath>
+#include <cstdint>
+
+class DenormalGuard {
+public:
+#if defined(FMG_DENORMALS_X86) || defined(FMG_DENORMALS_ARM64_MSVC) || \
+    defined(FMG_DENORMALS_ARM64) || defined(FMG_DENORMALS_ARM32)
+    static constexpr bool HARDWARE = true;
+#else
+    static constexpr bool HARDWARE = false;
+#endif
+
+    DenormalGuard() : saved_(read()) {
+        write(saved_ | FLUSH_BITS);
+    }
+    ~DenormalGuard() { write(saved_); }
+
+    DenormalGuard(const DenormalGuard&) = delete;
+    DenormalGuard& operator=(const DenormalGuard&) = delete;
+
+    // Whether the calling thread currently flushes denormals in hardware
+    static bool isFlushing() { return HARDWARE && (read() & FLUSH_BITS) == FLUSH_BITS; }
+
+private:
+#if defined(FMG_DENORMALS_X86)
+    static constexpr uint64_t FLUSH_BITS = 0x8040;   // FTZ | DAZ
+    static uint64_t read() { return _mm_getcsr(); }
+    static void write(uint64_t mode) { _mm_setcsr(static_cast<unsigned int>(mode)); }
+#elif defined(FMG_DENORMALS_ARM64_MSVC)
+    static constexpr uint64_t FLUSH_BITS = 1 << 24;   // FZ
+    static uint64_t read() { return _ReadStatusReg(ARM64_FPCR); }
+    static void write(uint64_t mode) { _WriteStatusReg(ARM64_FPCR, static_cast<__int64>(mode)); }
+#elif defined(FMG_DENORMALS_ARM64)
+    static constexpr uint64_t FLUSH_BITS = 1 << 24;   // FZ
+    static uint64_t read() {
+        uint64_t mode;
+        asm volatile("mrs %0, fpcr" : "=r"(mode));
+        return mode;
+    }
+    static void write(uint64_t mode) { asm volatile("msr fpcr, %0" : : "r"(mode)); }
+#elif defined(FMG_DENORMALS_ARM32)
+    static constexpr uint64_t FLUSH_BITS = 1 << 24;   // FZ
+    static uint64_t read() {
+        uint32_t mode;
+        asm volatile("vmrs %0, fpscr" : "=r"(mode));
+        return mode;
+    }
+    static void write(uint64_t mode) {
+        asm volatile("vmsr fpscr, %0" : : "r"(static_cast<uint32_t>(mode)));
+    }
+#else
+    static constexpr uint64_t FLUSH_BITS = 0;
+    static uint64_t read() { return 0; }
+    static void write(uint64_t) {}
+#endif
+
+    uint64_t saved_;
+};
+
+// Zero values too small to matter before they can decay into denormals. A no-op
+// when DenormalGuard flushes in hardware; called on feedback state.
+static inline float flushDenormal(float x) {
+    if constexpr (DenormalGuard::HARDWARE) {
+        return x;
+    } else {
+        return (std::fabs(x) < 1e-15f) ? 0.0f : x;
+    }
+}
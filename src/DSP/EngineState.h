@@ -0,0 +1,50 @@
+#pragma once
+
+// Every sound parameter of FMEngine in one value, in engine units (seconds, 0..1
+// levels, Hz). A preset is built into an EngineState on any thread, handed to the
+// audio thread, and applied with FMEngine::applyState(), which touches only what
+// differs from the current settings. Defaults are FMEngine's initial settings.
+//
+// Polyphony, oversampling and render threads are engine configuration rather than
+// sound, and keep their own setters.
+struct EngineState {
+    static constexpr int NUM_OPERATORS = 6;
+    static constexpr int NUM_LFOS = 2;
+
+    struct OperatorState {
+        float ratio;
+        float level;
+        float feedback;
+    };
+
+    struct LFOState {
+        float rate;
+        float depth;
+        int wave;
+    };
+
+    OperatorState operators[NUM_OPERATORS] = {
+        { 1.0f, 0.5f, 0.0f }, { 2.0f, 0.5f, 0.0f }, { 3.0f, 0.5f, 0.0f },
+        { 1.0f, 0.0f, 0.0f }, { 0.5f, 0.0f, 0.0f }, { 0.25f, 0.0f, 0.0f }
+    };
+    int algorithm = 0;                // 0-7
+
+    int filterType = 0;               // 0 lowpass, 1 highpass
+    int filterTopology = 0;           // 0 biquad, 1 state-variable
+    float filterCutoff = 12000.0f;
+    float filterResonance = 0.0f;
+
+    float attack = 0.01f;
+    float decay = 0.1f;
+    float sustain = 0.7f;
+    float release = 0.3f;
+
+    LFOState lfos[NUM_LFOS] = { { 1.0f, 0.0f, 0 }, { 2.0f, 0.0f, 0 } };
+
+    float chorusRate = 1.0f;
+    float chorusDepth = 0.3f;
+    float delayTime = 0.25f;
+    float delayFeedback = 0.3f;
+
+    float masterVolume = 0.7f;
+};
@@ -1,6 +1,7 @@
 #ifndef ENVELOPE_H
 #define ENVELOPE_H
 
+#include "Trace.h"
 #include <cmath>
 
 class Envelope {
@@ -14,19 +15,19 @@ public:
 
     void setAttack(float attack) {
         attack_ = clampf(attack, 0.001f, 5.0f);
-        calcCoefs();
+        dirty_ = true;
     }
     void setDecay(float decay) {
         decay_ = clampf(decay, 0.001f, 5.0f);
-        calcCoefs();
+        dirty_ = true;
     }
     void setSustain(float sustain) {
         sustain_ = clampf(sustain, 0.0f, 1.0f);
-        calcCoefs();
+        dirty_ = true;
     }
     void setRelease(float release) {
         release_ = clampf(release, 0.01f, 10.0f);
-        calcCoefs();
+        dirty_ = true;
     }
 
     float getAttack() const { return attack_; }
@@ -36,7 +37,14 @@ public:
 
     void setSampleRate(float sr) {
         sampleRate_ = sr;
-        calcCoefs();
+        dirty_ = true;
+    }
+
+    // The setters only store their value; this recomputes the rates once for
+    // everything changed since the last call. Call it before process() picks the
+    // changes up.
+    void updateCoefs() {
+        if (dirty_) calcCoefs();
     }
 
     void trigger() {
@@ -92,6 +100,8 @@ public:
 
 private:
     void calcCoefs() {
+        FMG_TRACE_SCOPE("Envelope::calcCoefs");
+        dirty_ = false;
         // Attack: linear ramp from 0 to 1 over attack_ seconds
         float attackSamples = attack_ * sampleRate_;
         attackRate_ = (attackSamples > 0.0f) ? (1.0f / attackSamples) : 1.0f;
@@ -122,6 +132,7 @@ private:
     float level_;
     State state_;
     float sampleRate_;
+    bool dirty_ = false;   // a setting changed since calcCoefs()
 };
 
 #endif
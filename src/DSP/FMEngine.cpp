@@ -1,32 +1,435 @@
 // FMEngine.cpp - Minimal implementation for template methods
 #include "FMEngine.h"
 #include <cmath>
+#include <algorithm>
+#include <cstring>
 
-void FMEngine::setVoiceBend(int note, float bendCents) {
-    for (int v = 0; v < NUM_VOICES; ++v) {
-        if (voices_[v].active && voices_[v].note == note) {
-            voices_[v].bendCents = bendCents;
-            float bendMultiplier = std::pow(2.0f, bendCents / 1200.0f);
-            for (int op = 0; op < NUM_OPERATORS; ++op) {
-                voices_[v].operators[op].setFrequency(
-                    voices_[v].frequency * bendMultiplier, sampleRate_);
+void FMEngine::setAlgorithm(int algo) {
+    static const VoiceKernel kernels[NUM_ALGORITHMS] = {
+        &FMEngine::renderVoiceChunk<0>, &FMEngine::renderVoiceChunk<1>,
+        &FMEngine::renderVoiceChunk<2>, &FMEngine::renderVoiceChunk<3>,
+        &FMEngine::renderVoiceChunk<4>, &FMEngine::renderVoiceChunk<5>,
+        &FMEngine::renderVoiceChunk<6>, &FMEngine::renderVoiceChunk<7>
+    };
+
+    algorithm_ = (algo >= 0 && algo < NUM_ALGORITHMS) ? algo : 0;
+    voiceKernel_ = kernels[algorithm_];
+    bankKernel_ = VoiceBank::kernelFor(algorithm_, filterTopology_);
+}
+
+EngineState FMEngine::getState() const {
+    EngineState state;
+    for (int op = 0; op < NUM_OPERATORS; ++op) {
+        state.operators[op] = { opRatio_[op], opLevel_[op], opFeedback_[op] };
+    }
+    state.algorithm = algorithm_;
+    state.filterType = filterType_;
+    state.filterTopology = (filterTopology_ == Filter::BIQUAD) ? 0 : 1;
+    state.filterCutoff = filterCutoff_;
+    state.filterResonance = filterResonance_;
+    state.attack = envAttack_;
+    state.decay = envDecay_;
+    state.sustain = envSustain_;
+    state.release = envRelease_;
+    for (int i = 0; i < NUM_LFOS; ++i) {
+        state.lfos[i] = { lfoRate_[i], lfoDepth_[i], lfoWave_[i] };
+    }
+    state.chorusRate = chorus_.getRate();
+    state.chorusDepth = chorus_.getDepth();
+    state.delayTime = delay_.getTime();
+    state.delayFeedback = delay_.getFeedback();
+    state.masterVolume = masterVolume_;
+    return state;
+}
+
+// Same result as calling each setter with its value, but only the fields that
+// differ from the stored settings are marked pending
+void FMEngine::applyState(const EngineState& state) {
+    FMG_TRACE_SCOPE("FMEngine::applyState");
+    for (int op = 0; op < NUM_OPERATORS; ++op) {
+        const EngineState::OperatorState& s = state.operators[op];
+        if (s.ratio == opRatio_[op] && s.level == opLevel_[op] && s.feedback == opFeedback_[op]) continue;
+        opRatio_[op] = s.ratio;
+        opLevel_[op] = s.level;
+        opFeedback_[op] = s.feedback;
+        pending_ |= PENDING_OPERATOR << op;
+    }
+    for (int i = 0; i < NUM_LFOS; ++i) {
+        const EngineState::LFOState& s = state.lfos[i];
+        if (s.rate == lfoRate_[i] && s.depth == lfoDepth_[i] && s.wave == lfoWave_[i]) continue;
+        lfoRate_[i] = s.rate;
+        lfoDepth_[i] = s.depth;
+        lfoWave_[i] = s.wave;
+        pending_ |= PENDING_LFO << i;
+    }
+
+    if (state.filterType != filterType_) setFilterType(state.filterType);
+    if (state.filterCutoff != filterCutoff_) setFilterCutoff(state.filterCutoff);
+    if (state.filterResonance != filterResonance_) setFilterResonance(state.filterResonance);
+    if (state.attack != envAttack_) setAttack(state.attack);
+    if (state.decay != envDecay_) setDecay(state.decay);
+    if (state.sustain != envSustain_) setSustain(state.sustain);
+    if (state.release != envRelease_) setRelease(state.release);
+
+    Filter::Topology topology = (state.filterTopology == 0) ? Filter::BIQUAD : Filter::SVF;
+    if (topology != filterTopology_) setFilterTopology(state.filterTopology);
+    if (state.algorithm != algorithm_) setAlgorithm(state.algorithm);
+
+    if (state.chorusRate != chorus_.getRate()) chorus_.setRate(state.chorusRate);
+    if (state.chorusDepth != chorus_.getDepth()) chorus_.setDepth(state.chorusDepth);
+    if (state.delayTime != delay_.getTime()) delay_.setTime(state.delayTime);
+    if (state.delayFeedback != delay_.getFeedback()) delay_.setFeedback(state.delayFeedback);
+    masterVolume_ = state.masterVolume;
+}
+
+// Hand the voice parameter changes since the last control update to the playing
+// voices, just before their next control step: one pass over the voices, only the
+// changed fields, and at most one envelope and one filter coefficient update per
+// voice
+void FMEngine::applyPendingParams() {
+    if (pending_ == 0) return;
+    FMG_TRACE_SCOPE("FMEngine::applyPendingParams");
+    const uint32_t pending = pending_;
+    pending_ = 0;
+    forEachActiveVoice([&](Voice& voice) {
+        for (int op = 0; op < NUM_OPERATORS; ++op) {
+            if (pending & (PENDING_OPERATOR << op)) applyOperatorParams(voice, op);
+        }
+        for (int i = 0; i < NUM_LFOS; ++i) {
+            if (!(pending & (PENDING_LFO << i))) continue;
+            voice.lfos[i].setRate(lfoRate_[i]);
+            voice.lfos[i].setDepth(lfoDepth_[i]);
+            voice.lfos[i].setWave(lfoWave_[i]);
+        }
+        if (pending & PENDING_ATTACK) voice.envelope.setAttack(envAttack_);
+        if (pending & PENDING_DECAY) voice.envelope.setDecay(envDecay_);
+        if (pending & PENDING_SUSTAIN) voice.envelope.setSustain(envSustain_);
+        if (pending & PENDING_RELEASE) voice.envelope.setRelease(envRelease_);
+        if (pending & PENDING_FILTER_TOPOLOGY) voice.filter.setTopology(filterTopology_);
+        if (pending & PENDING_FILTER_TYPE) voice.filter.setType(filterType_);
+        if (pending & PENDING_FILTER_RESONANCE) voice.filter.setResonance(filterResonance_);
+        voice.envelope.updateCoefs();
+        // A new type or topology changes what the coefficients mean, so it is set
+        // outright. A new resonance is left to the cutoff ramp of the control update
+        // that follows, which glides to it from the current coefficients whether or
+        // not the modulated cutoff moved.
+        if (pending & (PENDING_FILTER_TYPE | PENDING_FILTER_TOPOLOGY)) voice.filter.updateCoefs();
+    });
+}
+
+template<typename T>
+void FMEngine::process(T* outputLeft, T* outputRight, int numSamples) {
+    FMG_TRACE_SCOPE("FMEngine::process");
+    if (idle_) {
+        applyPendingParams();   // no voices to update
+        std::memset(outputLeft, 0, numSamples * sizeof(T));
+        std::memset(outputRight, 0, numSamples * sizeof(T));
+        return;
+    }
+
+    int ratio = oversampler_.getRatio();
+    int offset = 0;
+    while (offset < numSamples) {
+        // Parameter changes wait for the next control update, where every change
+        // made since the last one reaches the voices together
+        if (controlCountdown_ == 0) applyPendingParams();
+        int blockSize = std::min(numSamples - offset, MAX_BLOCK_SIZE / ratio);
+        if (pending_ != 0) blockSize = std::min(blockSize, controlCountdown_);
+
+        for (int bus = 0; bus < NUM_BUSES; ++bus) {
+            if (oversampler_.usesBus(bus)) {
+                std::fill(mixBuffer_[bus], mixBuffer_[bus] + (blockSize << bus), 0.0f);
             }
         }
+        renderVoices(blockSize);
+        reclaimVoices();
+        advanceControlClock(blockSize);
+
+        float* buses[NUM_BUSES] = { mixBuffer_[0], mixBuffer_[1], mixBuffer_[2] };
+        oversampler_.mixDown(buses, blockSize);
+        processEffects(mixBuffer_[0], outputLeft + offset, outputRight + offset, blockSize);
+        updateIdle(outputLeft + offset, outputRight + offset, blockSize);
+        offset += blockSize;
     }
 }
 
-void FMEngine::setVoicePressure(int note, float pressure) {
-    for (int v = 0; v < NUM_VOICES; ++v) {
-        if (voices_[v].active && voices_[v].note == note) {
-            voices_[v].pressure = pressure;
+template void FMEngine::process<float>(float*, float*, int);
+template void FMEngine::process<double>(double*, double*, int);
+
+// Count silent samples after the last voice ends. Below the threshold for a whole
+// tail, nothing that is still in the delay lines can come back above it: the
+// delayed signal has been heard at the output throughout, and feedback only
+// shrinks it.
+template<typename T>
+void FMEngine::updateIdle(const T* outputLeft, const T* outputRight, int numSamples) {
+    if (numActive_ > 0 || allocator_.getNumActive() > 0) {
+        silentSamples_ = 0;
+        return;
+    }
+    float peak = 0.0f;
+    for (int s = 0; s < numSamples; ++s) {
+        float left = std::fabs(static_cast<float>(outputLeft[s]));
+        float right = std::fabs(static_cast<float>(outputRight[s]));
+        peak = std::max(peak, std::max(left, right));
+    }
+    if (peak >= SILENCE_THRESHOLD) {
+        silentSamples_ = 0;
+        return;
+    }
+    silentSamples_ = std::min(silentSamples_ + numSamples, INT32_MAX / 2);
+    if (silentSamples_ > tailSamples()) idle_ = true;
+}
+
+// Render every active voice into its rate's bus in mixBuffer_. Voices are grouped by
+// rate; a work item is one voice, or up to VoiceBank::LANES voices of one rate on
+// the SIMD path. With enough voices playing, the items are shared with the render
+// pool and each thread sums into its own context; the contexts that took part are
+// added to the mix afterwards. numSamples counts output samples.
+void FMEngine::renderVoices(int numSamples) {
+    FMG_TRACE_SCOPE("FMEngine::renderVoices");
+    // Counting sort of the active voices by rate shift
+    int count[NUM_BUSES] = {};
+    allocator_.forEachActive([&](int v) { ++count[voices_[v].rateShift]; });
+    int start[NUM_BUSES];
+    numActive_ = 0;
+    for (int bus = 0; bus < NUM_BUSES; ++bus) {
+        start[bus] = numActive_;
+        numActive_ += count[bus];
+    }
+    FMG_TRACE_COUNTER("active voices", numActive_);
+    if (numActive_ == 0) return;
+    allocator_.forEachActive([&](int v) { activeVoices_[start[voices_[v].rateShift]++] = v; });
+
+    int lanes = voiceBankEnabled_ ? VoiceBank::LANES : 1;
+    numWorkItems_ = 0;
+    for (int bus = 0, first = 0; bus < NUM_BUSES; first += count[bus], ++bus) {
+        for (int i = 0; i < count[bus]; i += lanes) {
+            workItems_[numWorkItems_++] = { first + i, std::min(lanes, count[bus] - i), bus };
+        }
+    }
+    renderSamples_ = numSamples;
+
+    if (renderPool_.getNumWorkers() == 0 || numActive_ < PARALLEL_MIN_VOICES ||
+        numWorkItems_ < 2) {
+        for (int item = 0; item < numWorkItems_; ++item) {
+            renderWorkItem(contexts_[0], item, mixBuffer_);
+        }
+        return;
+    }
+
+    ++renderJob_;
+    renderPool_.run(&FMEngine::renderTask, this, numWorkItems_, RenderThreadPool::MAX_THREADS);
+
+    for (const RenderContext& context : contexts_) {
+        if (context.job != renderJob_) continue;
+        for (int bus = 0; bus < NUM_BUSES; ++bus) {
+            if (!oversampler_.usesBus(bus)) continue;
+            for (int s = 0; s < (numSamples << bus); ++s) {
+                mixBuffer_[bus][s] += context.mix[bus][s];
+            }
         }
     }
 }
 
-void FMEngine::setVoiceSlide(int note, float slideRate) {
-    for (int v = 0; v < NUM_VOICES; ++v) {
-        if (voices_[v].active && voices_[v].note == note) {
-            voices_[v].slideRate = slideRate;
+// Pool task: render one item into the calling thread's accumulator
+void FMEngine::renderTask(void* engine, int item, int thread) {
+    FMEngine* self = static_cast<FMEngine*>(engine);
+    RenderContext& context = self->contexts_[thread];
+    if (context.job != self->renderJob_) {
+        for (int bus = 0; bus < NUM_BUSES; ++bus) {
+            if (self->oversampler_.usesBus(bus)) {
+                std::fill(context.mix[bus], context.mix[bus] + (self->renderSamples_ << bus), 0.0f);
+            }
         }
+        context.job = self->renderJob_;
+    }
+    self->renderWorkItem(context, item, context.mix);
+}
+
+void FMEngine::renderWorkItem(RenderContext& context, int item, MixBuses& mix) {
+    const WorkItem& work = workItems_[item];
+    int numSamples = renderSamples_ << work.shift;
+    if (voiceBankEnabled_) {
+        renderVoiceBank(activeVoices_ + work.first, work.count, context, mix[work.shift],
+                        numSamples);
+    } else {
+        renderVoice(voices_[activeVoices_[work.first]], context, mix[work.shift], numSamples);
     }
 }
+
+// Render one voice over the block (numSamples at the voice's rate) and add it to
+// the mix. Spans end at RENDER_CHUNK and at control updates, which fall at the same
+// output positions for every voice.
+void FMEngine::renderVoice(Voice& voice, RenderContext& context, float* mix,
+                           int numSamples) {
+    int countdown = controlCountdown_ << voice.rateShift;
+    for (int pos = 0; pos < numSamples && voice.active;) {
+        if (countdown == 0) {
+            updateVoiceControls(voice);
+            countdown = controlInterval_ << voice.rateShift;
+        }
+        int n = std::min(std::min(RENDER_CHUNK, numSamples - pos), countdown);
+        (this->*voiceKernel_)(voice, context.voiceBuffer, n);
+
+        float* dst = mix + pos;
+        for (int s = 0; s < n; ++s) {
+            dst[s] += context.voiceBuffer[s];
+        }
+        pos += n;
+        countdown -= n;
+    }
+}
+
+// Control-rate update: step the LFOs one interval ahead and set pitch (bend,
+// vibrato) and filter cutoff (LFO2 sweep) gliding to their new targets over the
+// next interval
+void FMEngine::updateVoiceControls(Voice& voice) {
+    int interval = controlInterval_ << voice.rateShift;
+    for (int i = 0; i < NUM_LFOS; ++i) {
+        voice.lfos[i].advance(interval);
+    }
+
+    float freqMod = 1.0f + voice.lfos[0].getOutput() * 0.05f; // +/- 5% pitch modulation
+    voice.pitch = voice.frequency * voice.bendRatio * freqMod;
+    for (int op = 0; op < NUM_OPERATORS; ++op) {
+        voice.operators[op].rampFrequency(voice.pitch, interval);
+    }
+
+    float modCutoff = filterCutoff_ * (1.0f + voice.lfos[1].getOutput() * 0.5f);
+    voice.filter.rampCutoff(modCutoff, interval);
+}
+
+// Move the shared control clock past a rendered block (output samples)
+void FMEngine::advanceControlClock(int numSamples) {
+    if (numSamples <= controlCountdown_) {
+        controlCountdown_ -= numSamples;
+        return;
+    }
+    int sinceLast = (numSamples - controlCountdown_) % controlInterval_;
+    controlCountdown_ = (sinceLast == 0) ? 0 : controlInterval_ - sinceLast;
+}
+
+template<int A>
+void FMEngine::renderVoiceChunk(Voice& voice, float* out, int numSamples) {
+    for (int s = 0; s < numSamples; ++s) {
+        if (!voice.envelope.isActive()) {
+            // Voice finished mid-span: silence the remainder
+            voice.active = false;
+            std::fill(out + s, out + numSamples, 0.0f);
+            return;
+        }
+
+        voice.envelope.process();
+        float amp = voice.envelope.getLevel() * voice.velocity * masterVolume_;
+        amp *= (1.0f + voice.pressure * 0.5f);
+
+        // Operators in algorithm order, summed and normalized over the carriers
+        float voiceOut = evaluateAlgorithm<A>([&](auto op, float modInput) {
+            voice.operators[op].setModulatorInput(modInput);
+            voice.operators[op].process();
+            return voice.operators[op].getOutput();
+        }, 0.0f);
+
+        voiceOut *= amp;
+
+        voice.filter.process(voiceOut);
+        out[s] = voice.filter.getOutput();
+    }
+}
+
+// SIMD path: render up to VoiceBank::LANES voices of one rate together (numSamples
+// at that rate). Envelopes and control
+// updates stay scalar per voice; the operator stack and filter, including the
+// pitch and cutoff glides, run on all lanes at once.
+void FMEngine::renderVoiceBank(const int* voiceIndices, int numLanes, RenderContext& context,
+                               float* mix, int numSamples) {
+    VoiceBank& bank = context.bank;
+
+    bank.clear();
+    for (int l = 0; l < numLanes; ++l) {
+        Voice& voice = voices_[voiceIndices[l]];
+        bank.loadLane(l, voice.operators, voice.filter);
+    }
+
+    int shift = voices_[voiceIndices[0]].rateShift;
+    int countdown = controlCountdown_ << shift;
+    for (int pos = 0; pos < numSamples;) {
+        if (countdown == 0) {
+            for (int l = 0; l < numLanes; ++l) {
+                Voice& voice = voices_[voiceIndices[l]];
+                if (!voice.active) continue;
+                bank.storeLane(l, voice.operators, voice.filter);
+                updateVoiceControls(voice);
+                bank.loadLane(l, voice.operators, voice.filter);
+            }
+            countdown = controlInterval_ << shift;
+        }
+        int n = std::min(std::min(RENDER_CHUNK, numSamples - pos), countdown);
+        for (int l = 0; l < numLanes; ++l) {
+            prepareBankLane(voices_[voiceIndices[l]], bank, l, n);
+        }
+        (bank.*bankKernel_)(n);
+        bank.mixTo(mix + pos, n);
+        pos += n;
+        countdown -= n;
+    }
+
+    for (int l = 0; l < numLanes; ++l) {
+        Voice& voice = voices_[voiceIndices[l]];
+        bank.storeLane(l, voice.operators, voice.filter);
+    }
+}
+
+// Scalar envelope pass for one bank lane, mirroring renderVoiceChunk
+void FMEngine::prepareBankLane(Voice& voice, VoiceBank& bank, int lane, int numSamples) {
+    for (int s = 0; s < numSamples; ++s) {
+        if (!voice.active || !voice.envelope.isActive()) {
+            if (voice.active) {
+                voice.active = false;
+                bank.stopLane(lane);
+            }
+            bank.silence(s, lane);
+            continue;
+        }
+
+        voice.envelope.process();
+        float amp = voice.envelope.getLevel() * voice.velocity * masterVolume_;
+        amp *= (1.0f + voice.pressure * 0.5f);
+        bank.setGain(s, lane, amp);
+    }
+}
+
+// Global effects pass over the summed voice mix (stereo), one block per effect. The
+// delay writes the host's sample type directly.
+template<typename T>
+void FMEngine::processEffects(const float* mix, T* outputLeft, T* outputRight,
+                              int numSamples) {
+    FMG_TRACE_SCOPE("FMEngine::processEffects");
+    // Soft clip to prevent harsh distortion from stacked voices
+    for (int s = 0; s < numSamples; ++s) {
+        effectBuffer_[s] = mix[s] * 0.5f;
+    }
+    chorus_.processBlock(effectBuffer_, chorusLeft_, chorusRight_, numSamples);
+
+    for (int s = 0; s < numSamples; ++s) {
+        effectBuffer_[s] = chorusLeft_[s] + chorusRight_[s];
+    }
+    delay_.processBlock(effectBuffer_, outputLeft, outputRight, numSamples);
+}
+
+void FMEngine::setVoiceBend(int note, float bendCents) {
+    allocator_.forEachVoice(note, [&](int v) {
+        Voice& voice = voices_[v];
+        // Picked up by the next control update
+        voice.bendCents = bendCents;
+        voice.bendRatio = std::pow(2.0f, bendCents / 1200.0f);
+    });
+}
+
+void FMEngine::setVoicePressure(int note, float pressure) {
+    allocator_.forEachVoice(note, [&](int v) { voices_[v].pressure = pressure; });
+}
+
+void FMEngine::setVoiceSlide(int note, float slideRate) {
+    allocator_.forEachVoice(note, [&](int v) { voices_[v].slideRate = slideRate; });
+}
@@ -7,95 +7,51 @@
 #include "LFO.h"
 #include "StereoChorus.h"
 #include "StereoDelay.h"
-
-// Each algorithm defines: which operators modulate which, and which are carriers (go to output).
-// Operators are processed in the order specified by processOrder so modulators run before carriers.
-struct AlgorithmDef {
-    // For each operator, list of operator indices that modulate it (phase mod sources)
-    int modulators[6][6]; // modulators[op][i] = source op index, -1 = end
-    // Which operators are carriers (contribute to audio output)
-    bool isCarrier[6];
-    // Processing order: modulators first, then carriers
-    int processOrder[6];
-};
-
-// 8 algorithms matching the spec:
-// 1: 1>2>3>4>5>6 (serial chain, op6 is carrier)
-// 2: (1+2)>3>4>5>6 (ops 1,2 parallel into 3, chain to 6)
-// 3: 1>(2+3+4+5+6) (op1 modulates all, ops 2-6 are carriers)
-// 4: ((1+2)+(3+4))>5>6 (two pairs summed, chain to 6)
-// 5: 1>2, 3>4, 5>6 (3 parallel pairs; ops 2,4,6 are carriers)
-// 6: (1+2+3)>(4+5+6) (group 1-3 mods group 4-6; ops 4,5,6 are carriers)
-// 7: 1>2>3, 4>5>6 (2 parallel chains; ops 3,6 are carriers)
-// 8: All summed to output (no modulation, all carriers)
-static const AlgorithmDef kAlgorithms[8] = {
-    // Algo 1: 1>2>3>4>5>6 (serial). Carrier: 6 only.
-    // Op0 has no mod. Op1 modulated by op0. Op2 by op1. Op3 by op2. Op4 by op3. Op5 by op4.
-    {
-        {{-1},{0,-1},{1,-1},{2,-1},{3,-1},{4,-1}},
-        {false, false, false, false, false, true},
-        {0, 1, 2, 3, 4, 5}
-    },
-    // Algo 2: (1+2)>3>4>5>6. Carriers: 6.
-    // Op2 modulated by op0+op1. Op3 by op2. Op4 by op3. Op5 by op4.
-    {
-        {{-1},{-1},{0,1,-1},{2,-1},{3,-1},{4,-1}},
-        {false, false, false, false, false, true},
-        {0, 1, 2, 3, 4, 5}
-    },
-    // Algo 3: 1>(2+3+4+5+6). Op0 modulates ops 1-5. Carriers: 1,2,3,4,5.
-    {
-        {{-1},{0,-1},{0,-1},{0,-1},{0,-1},{0,-1}},
-        {false, true, true, true, true, true},
-        {0, 1, 2, 3, 4, 5}
-    },
-    // Algo 4: ((1+2)+(3+4))>5>6. Carriers: 6.
-    // Op4 modulated by op0+op1+op2+op3. Op5 by op4.
-    {
-        {{-1},{-1},{-1},{-1},{0,1,2,3,-1},{4,-1}},
-        {false, false, false, false, false, true},
-        {0, 1, 2, 3, 4, 5}
-    },
-    // Algo 5: 1>2, 3>4, 5>6 (3 parallel pairs). Carriers: 2,4,6 (indices 1,3,5).
-    {
-        {{-1},{0,-1},{-1},{2,-1},{-1},{4,-1}},
-        {false, true, false, true, false, true},
-        {0, 1, 2, 3, 4, 5}
-    },
-    // Algo 6: (1+2+3)>(4+5+6). Ops 0,1,2 modulate ops 3,4,5. Carriers: 4,5,6 (indices 3,4,5).
-    {
-        {{-1},{-1},{-1},{0,1,2,-1},{0,1,2,-1},{0,1,2,-1}},
-        {false, false, false, true, true, true},
-        {0, 1, 2, 3, 4, 5}
-    },
-    // Algo 7: 1>2>3, 4>5>6 (2 parallel chains). Carriers: 3,6 (indices 2,5).
-    {
-        {{-1},{0,-1},{1,-1},{-1},{3,-1},{4,-1}},
-        {false, false, true, false, false, true},
-        {0, 1, 2, 3, 4, 5}
-    },
-    // Algo 8: All summed to output (no modulation). All carriers.
-    {
-        {{-1},{-1},{-1},{-1},{-1},{-1}},
-        {true, true, true, true, true, true},
-        {0, 1, 2, 3, 4, 5}
-    }
-};
+#include "Algorithms.h"
+#include "VoiceBank.h"
+#include "RenderThreadPool.h"
+#include "VoiceAllocator.h"
+#include "Oversampler.h"
+#include "EngineState.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
 
 class FMEngine {
 public:
-    static const int NUM_OPERATORS = 6;
-    static const int NUM_ALGORITHMS = 8;
-    static const int NUM_VOICES = 16;
-    static const int NUM_LFOS = 2;
-
-    FMEngine() : sampleRate_(48000.0f), masterVolume_(0.7f), algorithm_(0),
-                 voiceAge_(0) {
-        for (int i = 0; i < NUM_VOICES; ++i) {
+    static constexpr int NUM_OPERATORS = 6;
+    static constexpr int NUM_ALGORITHMS = 8;
+    // Polyphony is set at runtime (setPolyphony) up to MAX_VOICES
+    static constexpr int MAX_VOICES = VoiceAllocator::MAX_VOICES;
+    static constexpr int DEFAULT_POLYPHONY = 16;
+    static constexpr int NUM_LFOS = 2;
+    // Internal render sizes. Voices are rendered RENDER_CHUNK samples at a time so
+    // their state stays in cache; host blocks longer than MAX_BLOCK_SIZE are split.
+    // MAX_BLOCK_SIZE counts samples at the highest voice rate, so with oversampling
+    // the output is produced in correspondingly shorter blocks.
+    static constexpr int RENDER_CHUNK = 32;
+    static constexpr int MAX_BLOCK_SIZE = 512;
+    // LFOs, pitch bend and the filter sweep are evaluated once per control interval
+    // and glided linearly in between (samples, configurable up to the maximum)
+    static constexpr int DEFAULT_CONTROL_INTERVAL = 16;
+    static constexpr int MAX_CONTROL_INTERVAL = 256;
+    // Below this many active voices a block is rendered on the calling thread only
+    static constexpr int PARALLEL_MIN_VOICES = 16;
+    // Output peak below which the effect tails count as silent (-100 dB)
+    static constexpr float SILENCE_THRESHOLD = 1e-5f;
+
+    FMEngine() : algorithm_(0), sampleRate_(48000.0f), masterVolume_(0.7f),
+                 voiceBankEnabled_(SIMD_ACCELERATED),
+                 controlInterval_(DEFAULT_CONTROL_INTERVAL), controlCountdown_(0),
+                 idle_(false), silentSamples_(0), numActive_(0), numWorkItems_(0),
+                 renderSamples_(0), renderJob_(0), contexts_(1) {
+        for (int i = 0; i < MAX_VOICES; ++i) {
             voices_[i].active = false;
             voices_[i].note = -1;
-            voices_[i].age = 0;
+            voices_[i].rateShift = 0;
         }
+        allocator_.reset(DEFAULT_POLYPHONY);
 
         // Default operator settings
         opRatio_[0] = 1.0f;  opLevel_[0] = 0.5f;  opFeedback_[0] = 0.0f;
@@ -111,6 +67,7 @@ public:
         envRelease_ = 0.3f;
 
         filterType_ = 0;
+        filterTopology_ = Filter::BIQUAD;
         filterCutoff_ = 12000.0f;
         filterResonance_ = 0.0f;
 
@@ -122,30 +79,38 @@ public:
 
         chorus_.setSampleRate(sampleRate_);
         delay_.setSampleRate(sampleRate_);
+
+        setAlgorithm(algorithm_);
     }
 
     void setSampleRate(float sr) {
         sampleRate_ = sr;
         chorus_.setSampleRate(sr);
         delay_.setSampleRate(sr);
+        wake();
         // Update all active voices
-        for (int v = 0; v < NUM_VOICES; ++v) {
-            if (voices_[v].active) {
-                applyParamsToVoice(voices_[v]);
-            }
-        }
+        forEachActiveVoice([this](Voice& voice) {
+            voice.rateShift = rateShiftFor(voice);
+            applyParamsToVoice(voice);
+        });
     }
 
     void noteOn(int note, float velocity) {
-        int voiceIndex = findFreeVoice();
-        if (voiceIndex < 0) voiceIndex = stealVoice();
+        FMG_TRACE_SCOPE("FMEngine::noteOn");
+        int voiceIndex = allocator_.noteOn(note, [this](int v) {
+            return voices_[v].envelope.getLevel() * voices_[v].velocity;
+        });
 
         Voice& voice = voices_[voiceIndex];
+        wake();
         voice.active = true;
         voice.note = note;
         voice.velocity = velocity;
         voice.frequency = 440.0f * std::pow(2.0f, (note - 69) / 12.0f);
-        voice.age = ++voiceAge_;
+        voice.pitch = voice.frequency;
+        voice.bendCents = 0.0f;
+        voice.bendRatio = 1.0f;
+        voice.rateShift = rateShiftFor(voice);
 
         for (int i = 0; i < NUM_OPERATORS; ++i) {
             voice.operators[i].reset();
@@ -161,202 +126,106 @@ public:
     }
 
     void noteOff(int note) {
-        for (int i = 0; i < NUM_VOICES; ++i) {
-            if (voices_[i].active && voices_[i].note == note) {
-                voices_[i].envelope.release();
-            }
-        }
-    }
-
-    void process(float* outputLeft, float* outputRight, int numSamples) {
-        for (int s = 0; s < numSamples; ++s) {
-            float mix = 0.0f;
-
-            for (int v = 0; v < NUM_VOICES; ++v) {
-                Voice& voice = voices_[v];
-
-                if (!voice.active) continue;
-                if (!voice.envelope.isActive()) {
-                    voice.active = false;
-                    continue;
-                }
-
-                // Process LFOs
-                for (int i = 0; i < NUM_LFOS; ++i) {
-                    voice.lfos[i].process();
-                }
-
-                // Apply LFO1 to operator ratios (vibrato)
-                float lfo1Out = voice.lfos[0].getOutput();
-                // Apply LFO2 to filter cutoff
-                float lfo2Out = voice.lfos[1].getOutput();
-
-                // Update operator frequencies with LFO1 vibrato
-                for (int op = 0; op < NUM_OPERATORS; ++op) {
-                    float freqMod = 1.0f + lfo1Out * 0.05f; // +/- 5% pitch modulation
-                    voice.operators[op].setFrequency(
-                        voice.frequency * freqMod, sampleRate_);
-                }
-
-                // Process envelope
-                voice.envelope.process();
-                float amp = voice.envelope.getLevel() * voice.velocity * masterVolume_;
-                amp *= (1.0f + voice.pressure * 0.5f);
-
-                // Process operators in algorithm order
-                const AlgorithmDef& algo = kAlgorithms[algorithm_];
-                float opOutput[NUM_OPERATORS] = {0.0f};
-
-                for (int idx = 0; idx < NUM_OPERATORS; ++idx) {
-                    int op = algo.processOrder[idx];
-
-                    // Sum modulation inputs from this op's modulators
-                    float modInput = 0.0f;
-                    for (int m = 0; m < NUM_OPERATORS; ++m) {
-                        int modSrc = algo.modulators[op][m];
-                        if (modSrc < 0) break;
-                        modInput += opOutput[modSrc] * 5.0f;
-                    }
-
-                    voice.operators[op].setModulatorInput(modInput);
-                    voice.operators[op].process();
-                    opOutput[op] = voice.operators[op].getOutput();
-                }
-
-                // Sum only carrier operators
-                float voiceOut = 0.0f;
-                int numCarriers = 0;
-                for (int op = 0; op < NUM_OPERATORS; ++op) {
-                    if (algo.isCarrier[op]) {
-                        voiceOut += opOutput[op];
-                        numCarriers++;
-                    }
-                }
-                // Normalize by number of carriers to keep consistent level
-                if (numCarriers > 1) {
-                    voiceOut /= std::sqrt(static_cast<float>(numCarriers));
-                }
-
-                voiceOut *= amp;
-
-                // Apply filter with LFO2 modulation on cutoff
-                float modCutoff = filterCutoff_ * (1.0f + lfo2Out * 0.5f);
-                if (modCutoff < 20.0f) modCutoff = 20.0f;
-                if (modCutoff > 20000.0f) modCutoff = 20000.0f;
-                voice.filter.setCutoff(modCutoff);
-                voice.filter.process(voiceOut);
-                float filtered = voice.filter.getOutput();
-
-                mix += filtered;
-            }
-
-            // Soft clip to prevent harsh distortion from stacked voices
-            mix *= 0.5f;
-
-            // Effects chain (global, not per-voice) - stereo
-            float chorusL, chorusR;
-            chorus_.process(mix, chorusL, chorusR);
-
-            float delayL, delayR;
-            delay_.process(chorusL + chorusR, delayL, delayR);
-
-            outputLeft[s] = delayL;
-            outputRight[s] = delayR;
-        }
+        allocator_.noteOff(note, [this](int v) { voices_[v].envelope.release(); });
     }
 
-    // Parameter setters — update stored values AND propagate to all active voices
+    // Renders numSamples of stereo output. Voices are rendered one at a time in
+    // RENDER_CHUNK pieces and summed into the mix bus; the global chorus and delay
+    // then run over the whole mix as a separate pass. While idle the output is
+    // zeroed and nothing else runs. T is float or double: voices and effects run in
+    // float, and the last stage writes T directly.
+    template<typename T>
+    void process(T* outputLeft, T* outputRight, int numSamples);
+
+    // True once no voice has played and the output has stayed below
+    // SILENCE_THRESHOLD for longer than the longest effect tail. Cleared by the
+    // next note.
+    bool isIdle() const { return idle_; }
+
+    // All sound parameters at once (presets, program changes). applyState() compares
+    // with the current settings and queues only what changed, like the setters.
+    EngineState getState() const;
+    void applyState(const EngineState& state);
+
+    // Parameter setters. Voice parameters are stored and marked pending; the next
+    // control update (see nextControlUpdate) hands every pending change to the
+    // playing voices in one pass, and each voice recomputes its envelope and filter
+    // coefficients once, however many of their settings changed in between.
     void setOperatorRatio(int op, float ratio) {
         if (op >= 0 && op < NUM_OPERATORS) {
             opRatio_[op] = ratio;
-            propagateOperatorParams();
+            pending_ |= PENDING_OPERATOR << op;
         }
     }
 
     void setOperatorLevel(int op, float level) {
         if (op >= 0 && op < NUM_OPERATORS) {
             opLevel_[op] = level;
-            propagateOperatorParams();
+            pending_ |= PENDING_OPERATOR << op;
         }
     }
 
     void setOperatorFeedback(int op, float fb) {
         if (op >= 0 && op < NUM_OPERATORS) {
             opFeedback_[op] = fb;
-            propagateOperatorParams();
+            pending_ |= PENDING_OPERATOR << op;
         }
     }
 
-    void setAlgorithm(int algo) {
-        algorithm_ = (algo >= 0 && algo < NUM_ALGORITHMS) ? algo : 0;
-    }
+    // Selects the algorithm and its specialized render kernels
+    void setAlgorithm(int algo);
 
     void setFilterType(int type) {
         filterType_ = type;
-        for (int v = 0; v < NUM_VOICES; ++v) {
-            if (voices_[v].active) voices_[v].filter.setType(type);
-        }
+        pending_ |= PENDING_FILTER_TYPE;
     }
-    void setFilterCutoff(float cutoff) {
-        filterCutoff_ = cutoff;
-        for (int v = 0; v < NUM_VOICES; ++v) {
-            if (voices_[v].active) voices_[v].filter.setCutoff(cutoff);
-        }
+    // Biquad (0) or TPT state-variable filter (1) for every voice
+    void setFilterTopology(int topology) {
+        filterTopology_ = (topology == 0) ? Filter::BIQUAD : Filter::SVF;
+        pending_ |= PENDING_FILTER_TOPOLOGY;
+        bankKernel_ = VoiceBank::kernelFor(algorithm_, filterTopology_);
     }
+    // The voices glide to a new cutoff from their next control update, with the
+    // LFO2 sweep on top, like any cutoff modulation
+    void setFilterCutoff(float cutoff) { filterCutoff_ = cutoff; }
     void setFilterResonance(float res) {
         filterResonance_ = res;
-        for (int v = 0; v < NUM_VOICES; ++v) {
-            if (voices_[v].active) voices_[v].filter.setResonance(res);
-        }
+        pending_ |= PENDING_FILTER_RESONANCE;
     }
 
     void setAttack(float attack) {
         envAttack_ = attack;
-        for (int v = 0; v < NUM_VOICES; ++v) {
-            if (voices_[v].active) voices_[v].envelope.setAttack(attack);
-        }
+        pending_ |= PENDING_ATTACK;
     }
     void setDecay(float decay) {
         envDecay_ = decay;
-        for (int v = 0; v < NUM_VOICES; ++v) {
-            if (voices_[v].active) voices_[v].envelope.setDecay(decay);
-        }
+        pending_ |= PENDING_DECAY;
     }
     void setSustain(float sustain) {
         envSustain_ = sustain;
-        for (int v = 0; v < NUM_VOICES; ++v) {
-            if (voices_[v].active) voices_[v].envelope.setSustain(sustain);
-        }
+        pending_ |= PENDING_SUSTAIN;
     }
     void setRelease(float release) {
         envRelease_ = release;
-        for (int v = 0; v < NUM_VOICES; ++v) {
-            if (voices_[v].active) voices_[v].envelope.setRelease(release);
-        }
+        pending_ |= PENDING_RELEASE;
     }
 
     void setLFORate(int lfo, float rate) {
         if (lfo >= 0 && lfo < NUM_LFOS) {
             lfoRate_[lfo] = rate;
-            for (int v = 0; v < NUM_VOICES; ++v) {
-                if (voices_[v].active) voices_[v].lfos[lfo].setRate(rate);
-            }
+            pending_ |= PENDING_LFO << lfo;
         }
     }
     void setLFODepth(int lfo, float depth) {
         if (lfo >= 0 && lfo < NUM_LFOS) {
             lfoDepth_[lfo] = depth;
-            for (int v = 0; v < NUM_VOICES; ++v) {
-                if (voices_[v].active) voices_[v].lfos[lfo].setDepth(depth);
-            }
+            pending_ |= PENDING_LFO << lfo;
         }
     }
     void setLFOWave(int lfo, int wave) {
         if (lfo >= 0 && lfo < NUM_LFOS) {
             lfoWave_[lfo] = wave;
-            for (int v = 0; v < NUM_VOICES; ++v) {
-                if (voices_[v].active) voices_[v].lfos[lfo].setWave(wave);
-            }
+            pending_ |= PENDING_LFO << lfo;
         }
     }
 
@@ -366,6 +235,81 @@ public:
     void setDelayFeedback(float fb) { delay_.setFeedback(fb); }
 
     void setMasterVolume(float vol) { masterVolume_ = vol; }
+
+    // Render voices through the SIMD voice bank (default when the build targets
+    // SSE2/AVX2) or one at a time through the scalar reference path
+    void setVoiceBankEnabled(bool enabled) { voiceBankEnabled_ = enabled; }
+    bool isVoiceBankEnabled() const { return voiceBankEnabled_; }
+
+    // Samples (at the output rate) between control-rate updates of LFOs, pitch bend
+    // and filter cutoff
+    void setControlInterval(int samples) {
+        controlInterval_ = std::max(1, std::min(samples, MAX_CONTROL_INTERVAL));
+        controlCountdown_ = 0;
+    }
+    int getControlInterval() const { return controlInterval_; }
+
+    // Samples from the start of the next process() call to the first control update
+    // at or after offset. Voice parameter changes take effect at control updates, so
+    // a caller applying changes at their sample offset only needs to split its
+    // process() calls there, and every change up to it costs one update.
+    int nextControlUpdate(int offset) const {
+        int update = controlCountdown_;
+        if (offset > update) {
+            update += (offset - update + controlInterval_ - 1) / controlInterval_ * controlInterval_;
+        }
+        return update;
+    }
+
+    // Run the voices at 2x or 4x the output rate and decimate their mix before the
+    // effects. In Auto mode each voice gets the lowest of 1x, 2x and 4x that holds
+    // its estimated bandwidth (see rateShiftFor). Playing voices whose rate changes
+    // are moved to the new rate.
+    void setOversampling(OversampleMode mode) {
+        if (mode == oversampler_.getMode()) return;
+        oversampler_.setMode(mode);
+        forEachActiveVoice([this](Voice& voice) {
+            int shift = rateShiftFor(voice);
+            if (shift == voice.rateShift) return;
+            voice.rateShift = shift;
+            applyParamsToVoice(voice);
+        });
+    }
+    OversampleMode getOversampling() const { return oversampler_.getMode(); }
+    // Highest voice rate, as a multiple of the output rate
+    int getOversampleRatio() const { return oversampler_.getRatio(); }
+
+    // Linear-phase FIR or low-latency IIR decimation filters
+    void setOversampleFilter(OversampleFilter filter) {
+        if (filter != oversampler_.getFilter()) oversampler_.setFilter(filter);
+    }
+    OversampleFilter getOversampleFilter() const { return oversampler_.getFilter(); }
+
+    // Output delay added by oversampling, in samples
+    float getLatency() const { return oversampler_.getLatency(); }
+
+    // Number of voices (1..MAX_VOICES). Voices above a reduced count are cut off.
+    void setPolyphony(int voices) {
+        allocator_.resize(voices, [this](int v) { voices_[v].active = false; });
+    }
+    int getPolyphony() const { return allocator_.getNumVoices(); }
+    // Voices playing or releasing, and voices stolen so far (see VoiceAllocator)
+    int getNumActiveVoices() const { return allocator_.getNumActive(); }
+    uint32_t getNumSteals() const { return allocator_.getNumSteals(); }
+
+    // How a voice is chosen when a note arrives with every voice busy
+    void setStealPolicy(VoiceAllocator::StealPolicy policy) { allocator_.setStealPolicy(policy); }
+    VoiceAllocator::StealPolicy getStealPolicy() const { return allocator_.getStealPolicy(); }
+
+    // Worker threads that help the calling thread render voices (0 = render on the
+    // calling thread only). Starts and stops threads, so call it outside process().
+    void setRenderThreads(int numWorkers) {
+        numWorkers = std::max(0, std::min(numWorkers, RenderThreadPool::MAX_THREADS - 1));
+        if (numWorkers == renderPool_.getNumWorkers()) return;
+        renderPool_.start(numWorkers);
+        contexts_.resize(1 + renderPool_.getNumWorkers());
+    }
+    int getRenderThreads() const { return renderPool_.getNumWorkers(); }
     
     void setVoiceBend(int note, float bendCents);
     void setVoicePressure(int note, float pressure);
@@ -385,6 +329,7 @@ public:
     float getFilterCutoff() const { return filterCutoff_; }
     float getFilterResonance() const { return filterResonance_; }
     int getFilterType() const { return filterType_; }
+    int getFilterTopology() const { return filterTopology_; }
 
     float getAttack() const { return envAttack_; }
     float getDecay() const { return envDecay_; }
@@ -407,75 +352,170 @@ private:
         int note;
         float velocity;
         float frequency;
-        unsigned long age;
+        float pitch;        // frequency with bend and vibrato, last control update
         float bendCents = 0.0f;
+        float bendRatio = 1.0f;
         float pressure = 0.0f;
         float slideRate = 0.0f;
+        int rateShift;      // renders at sampleRate_ << rateShift (1x, 2x or 4x)
         Operator operators[NUM_OPERATORS];
         Envelope envelope;
         Filter filter;
         LFO lfos[NUM_LFOS];
     };
 
+    float voiceRate(const Voice& voice) const {
+        return sampleRate_ * static_cast<float>(1 << voice.rateShift);
+    }
+
+    // Oversampling shift for a voice: fixed by the mode, or in Auto mode the lowest
+    // rate whose Nyquist frequency is above the voice's highest significant partial.
+    // That is estimated with Carson's rule, walking the algorithm from modulators to
+    // carriers: an operator modulated with index I by a source whose spectrum reaches
+    // fm spreads by (I + 1) * fm around its own frequency. Indices follow the
+    // operators (5 radians per unit of modulator level or feedback), and vibrato
+    // depth is included. Estimated once per note, at note on.
+    int rateShiftFor(const Voice& voice) const {
+        switch (oversampler_.getMode()) {
+            case OversampleMode::x2: return 1;
+            case OversampleMode::x4: return 2;
+            case OversampleMode::Auto: break;
+            default: return 0;
+        }
+
+        const AlgorithmDef& algo = kAlgorithms[algorithm_];
+        float pitch = voice.frequency * voice.bendRatio * (1.0f + lfoDepth_[0] * 0.05f);
+        float top[NUM_OPERATORS];
+        float highest = 0.0f;
+        for (int i = 0; i < NUM_OPERATORS; ++i) {
+            int op = algo.processOrder[i];
+            float freq = opRatio_[op] * pitch;
+            float spread = 0.0f;
+            for (int m = 0; m < NUM_OPERATORS && algo.modulators[op][m] >= 0; ++m) {
+                int src = algo.modulators[op][m];
+                if (opLevel_[src] > 0.0f) spread += (opLevel_[src] * 5.0f + 1.0f) * top[src];
+            }
+            if (opFeedback_[op] > 0.0f) {
+                spread += (opFeedback_[op] * opLevel_[op] * 5.0f + 1.0f) * freq;
+            }
+            top[op] = freq + spread;
+            if (algo.isCarrier[op] && opLevel_[op] > 0.0f) highest = std::max(highest, top[op]);
+        }
+
+        if (highest <= sampleRate_ * 0.5f) return 0;
+        return (highest <= sampleRate_) ? 1 : 2;
+    }
+
     // Apply all stored parameters to a voice (used on noteOn and setSampleRate)
     void applyParamsToVoice(Voice& voice) {
+        FMG_TRACE_SCOPE("FMEngine::applyParamsToVoice");
+        float rate = voiceRate(voice);
         for (int i = 0; i < NUM_OPERATORS; ++i) {
-            voice.operators[i].setSampleRate(sampleRate_);
+            voice.operators[i].setSampleRate(rate);
             voice.operators[i].setRatio(opRatio_[i]);
             voice.operators[i].setLevel(opLevel_[i]);
             voice.operators[i].setFeedback(opFeedback_[i]);
-            voice.operators[i].setFrequency(voice.frequency, sampleRate_);
+            voice.operators[i].setFrequency(voice.pitch, rate);
         }
-        voice.envelope.setSampleRate(sampleRate_);
+        voice.envelope.setSampleRate(rate);
         voice.envelope.setAttack(envAttack_);
         voice.envelope.setDecay(envDecay_);
         voice.envelope.setSustain(envSustain_);
         voice.envelope.setRelease(envRelease_);
 
-        voice.filter.setSampleRate(sampleRate_);
+        voice.filter.setSampleRate(rate);
+        voice.filter.setTopology(filterTopology_);
         voice.filter.setType(filterType_);
         voice.filter.setCutoff(filterCutoff_);
         voice.filter.setResonance(filterResonance_);
 
         for (int i = 0; i < NUM_LFOS; ++i) {
-            voice.lfos[i].setSampleRate(sampleRate_);
+            voice.lfos[i].setSampleRate(rate);
             voice.lfos[i].setRate(lfoRate_[i]);
             voice.lfos[i].setDepth(lfoDepth_[i]);
             voice.lfos[i].setWave(lfoWave_[i]);
         }
+        voice.envelope.updateCoefs();
+        voice.filter.updateCoefs();
     }
 
-    // Propagate operator params to all active voices
-    void propagateOperatorParams() {
-        for (int v = 0; v < NUM_VOICES; ++v) {
-            if (voices_[v].active) {
-                for (int i = 0; i < NUM_OPERATORS; ++i) {
-                    voices_[v].operators[i].setRatio(opRatio_[i]);
-                    voices_[v].operators[i].setLevel(opLevel_[i]);
-                    voices_[v].operators[i].setFeedback(opFeedback_[i]);
-                    voices_[v].operators[i].setFrequency(
-                        voices_[v].frequency, sampleRate_);
-                }
-            }
-        }
+    // Voice parameters changed since the last control update, one bit per group
+    enum : uint32_t {
+        PENDING_OPERATOR = 1u << 0,            // << operator index
+        PENDING_LFO = 1u << NUM_OPERATORS,     // << LFO index
+        PENDING_ATTACK = PENDING_LFO << NUM_LFOS,
+        PENDING_DECAY = PENDING_ATTACK << 1,
+        PENDING_SUSTAIN = PENDING_ATTACK << 2,
+        PENDING_RELEASE = PENDING_ATTACK << 3,
+        PENDING_FILTER_TYPE = PENDING_ATTACK << 4,
+        PENDING_FILTER_TOPOLOGY = PENDING_ATTACK << 5,
+        PENDING_FILTER_RESONANCE = PENDING_ATTACK << 6
+    };
+
+    void applyPendingParams();
+
+    void applyOperatorParams(Voice& voice, int op) {
+        voice.operators[op].setRatio(opRatio_[op]);
+        voice.operators[op].setLevel(opLevel_[op]);
+        voice.operators[op].setFeedback(opFeedback_[op]);
+        voice.operators[op].setFrequency(voice.pitch, voiceRate(voice));
     }
 
-    int findFreeVoice() {
-        for (int i = 0; i < NUM_VOICES; ++i) {
-            if (!voices_[i].active) return i;
-        }
-        return -1;
+    // Voices are mixed on one bus per rate: bus[shift] runs at sampleRate_ << shift
+    static constexpr int NUM_BUSES = Oversampler::NUM_BUSES;
+    typedef float MixBuses[NUM_BUSES][MAX_BLOCK_SIZE];
+
+    // Per-thread render scratch: one voice chunk, a voice bank, and the thread's
+    // share of the voice mix
+    struct alignas(64) RenderContext {
+        float voiceBuffer[RENDER_CHUNK];
+        alignas(64) MixBuses mix;
+        VoiceBank bank;
+        uint32_t job = 0;   // render job that mix was last cleared for
+    };
+
+    void renderVoices(int numSamples);
+    static void renderTask(void* engine, int item, int thread);
+    void renderWorkItem(RenderContext& context, int item, MixBuses& mix);
+    void renderVoice(Voice& voice, RenderContext& context, float* mix, int numSamples);
+    void updateVoiceControls(Voice& voice);
+    void advanceControlClock(int numSamples);
+    // One straight-line kernel per algorithm, chosen in setAlgorithm(). Renders a
+    // span with no control update inside it.
+    typedef void (FMEngine::*VoiceKernel)(Voice& voice, float* out, int numSamples);
+    template<int A>
+    void renderVoiceChunk(Voice& voice, float* out, int numSamples);
+    void renderVoiceBank(const int* voiceIndices, int numLanes, RenderContext& context,
+                         float* mix, int numSamples);
+    void prepareBankLane(Voice& voice, VoiceBank& bank, int lane, int numSamples);
+    template<typename T>
+    void processEffects(const float* mix, T* outputLeft, T* outputRight, int numSamples);
+
+    template<typename F>
+    void forEachActiveVoice(F f) {
+        allocator_.forEachActive([&](int v) { f(voices_[v]); });
     }
 
-    // Steal the oldest voice (lowest age value)
-    int stealVoice() {
-        int oldest = 0;
-        for (int i = 1; i < NUM_VOICES; ++i) {
-            if (voices_[i].age < voices_[oldest].age) {
-                oldest = i;
-            }
+    // Samples a signal can take to leave the effects and decimators once the
+    // voices stop, before the feedback decay
+    int tailSamples() const {
+        return chorus_.getTailSamples() + delay_.getTailSamples() +
+               static_cast<int>(oversampler_.getLatency()) + 1;
+    }
+
+    template<typename T>
+    void updateIdle(const T* outputLeft, const T* outputRight, int numSamples);
+
+    void wake() {
+        idle_ = false;
+        silentSamples_ = 0;
+    }
+
+    // Hand voices that finished during the last block back to the allocator
+    void reclaimVoices() {
+        for (int i = 0; i < numActive_; ++i) {
+            if (!voices_[activeVoices_[i]].active) allocator_.release(activeVoices_[i]);
         }
-        return oldest;
     }
 
     // Stored parameter values (source of truth)
@@ -485,6 +525,7 @@ private:
 
     float envAttack_, envDecay_, envSustain_, envRelease_;
     int filterType_;
+    Filter::Topology filterTopology_;
     float filterCutoff_, filterResonance_;
     float lfoRate_[NUM_LFOS], lfoDepth_[NUM_LFOS];
     int lfoWave_[NUM_LFOS];
@@ -493,12 +534,52 @@ private:
     StereoChorus chorus_;
     StereoDelay delay_;
 
-    Voice voices_[NUM_VOICES];
+    Voice voices_[MAX_VOICES];
+
+    // Summed voice mix for a block, one bus per voice rate; the oversampler mixes
+    // them down into mixBuffer_[0]
+    alignas(64) MixBuses mixBuffer_;
+    alignas(64) float effectBuffer_[MAX_BLOCK_SIZE];   // effect input
+    alignas(64) float chorusLeft_[MAX_BLOCK_SIZE];
+    alignas(64) float chorusRight_[MAX_BLOCK_SIZE];
+    Oversampler oversampler_;
+    static_assert(MAX_BLOCK_SIZE / 2 <= Oversampler::MAX_OUTPUT, "oversampler blocks too small");
+
+    static_assert(RENDER_CHUNK <= VoiceBank::MAX_CHUNK, "voice bank chunk too small");
+    static_assert(EngineState::NUM_OPERATORS == NUM_OPERATORS && EngineState::NUM_LFOS == NUM_LFOS,
+                  "EngineState out of step with the engine");
 
     int algorithm_;
+    VoiceKernel voiceKernel_;
+    VoiceBank::Kernel bankKernel_;
     float sampleRate_;
     float masterVolume_;
-    unsigned long voiceAge_;
+    bool voiceBankEnabled_;
+    int controlInterval_;   // in output samples
+    int controlCountdown_;  // output samples until the next control update
+    bool idle_;
+    int silentSamples_;     // consecutive silent output samples with no voices
+    VoiceAllocator allocator_;
+    uint32_t pending_ = 0;  // PENDING_* bits
+
+    // A run of activeVoices_ rendered together, all at one rate
+    struct WorkItem {
+        int first;
+        int count;
+        int shift;
+    };
+
+    // Current render job: active voice indices, grouped by rate, and how they are
+    // split into items
+    int activeVoices_[MAX_VOICES];
+    int numActive_;
+    WorkItem workItems_[MAX_VOICES];
+    int numWorkItems_;
+    int renderSamples_;     // output samples
+    uint32_t renderJob_;
+
+    std::vector<RenderContext> contexts_;   // [0] is the calling thread's
+    RenderThreadPool renderPool_;
 };
 
 #endif
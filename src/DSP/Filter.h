@@ -1,91 +1,164 @@
 #ifndef FILTER_H
 #define FILTER_H
 
+#include "CutoffTable.h"
+#include "DenormalGuard.h"
+#include "Trace.h"
 #include <cmath>
 
-// 2-pole biquad filter (12dB/oct) with resonance
+// 2-pole filter (12dB/oct) with resonance: RBJ biquad, or a TPT state-variable filter
+// (trapezoidal integrators) that stays well behaved under fast cutoff modulation.
+// Both derive their coefficients from the table prewarp K = tan(pi * fc / fs), so a
+// cutoff change costs a table lookup and no trigonometry.
 class Filter {
 public:
     enum Type { LOWPASS, HIGHPASS };
+    enum Topology { BIQUAD, SVF };
 
-    Filter() : type_(LOWPASS), cutoff_(12000.0f), resonance_(0.0f),
-               sampleRate_(48000.0f), output_(0.0f),
-               b0_(1.0f), b1_(0.0f), b2_(0.0f),
-               a1_(0.0f), a2_(0.0f), z1_(0.0f), z2_(0.0f) {
+    // Coefficient slots. Biquad: b0, b1, b2, a1, a2. SVF: a1, a2, a3 (integrator
+    // gains) and m0, m1 (input and band-pass mix; the low-pass mix is 1 - 2 * m0).
+    static const int NUM_COEFS = 5;
+
+    Filter() : type_(LOWPASS), topology_(BIQUAD), cutoff_(12000.0f), resonance_(0.0f),
+               sampleRate_(48000.0f), output_(0.0f), s1_(0.0f), s2_(0.0f) {
         calcCoefs();
     }
 
-    void setType(Type type) { type_ = type; calcCoefs(); }
-    void setType(int type) { type_ = (type == 0) ? LOWPASS : HIGHPASS; calcCoefs(); }
+    // The setters only store their value; updateCoefs() then recomputes the
+    // coefficients once for everything that changed. Call it before process() or a
+    // voice bank picks the changes up.
+    void setType(Type type) { type_ = type; dirty_ = true; }
+    void setType(int type) { setType((type == 0) ? LOWPASS : HIGHPASS); }
+
+    // The two topologies keep different state, so switching clears it
+    void setTopology(Topology topology) {
+        if (topology == topology_) return;
+        topology_ = topology;
+        s1_ = s2_ = 0.0f;
+        dirty_ = true;
+    }
+    void setTopology(int topology) { setTopology(topology == 0 ? BIQUAD : SVF); }
 
     void setCutoff(float cutoff) {
         cutoff_ = clampf(cutoff, 20.0f, 20000.0f);
-        calcCoefs();
+        dirty_ = true;
     }
 
     void setResonance(float res) {
         resonance_ = clampf(res, 0.0f, 1.0f);
-        calcCoefs();
+        dirty_ = true;
     }
 
     void setSampleRate(float sr) {
         sampleRate_ = sr;
+        dirty_ = true;
+    }
+
+    // Recompute the coefficients if a setting changed; stops any ramp
+    void updateCoefs() {
+        if (dirty_) calcCoefs();
+    }
+
+    // Glide the coefficients linearly toward those for cutoff over numSamples
+    // (control-rate modulation), picking up any other setting changed since the
+    // last update. The caller retargets before the ramp runs out.
+    void rampCutoff(float cutoff, int numSamples) {
+        // Control-rate point for the software flush (see DenormalGuard)
+        s1_ = flushDenormal(s1_);
+        s2_ = flushDenormal(s2_);
+
+        cutoff = clampf(cutoff, 20.0f, 20000.0f);
+        if (cutoff == cutoff_ && !dirty_) {
+            // Nothing changed: the previous ramp has arrived, settle on it exactly
+            if (isRamping()) calcCoefs();
+            return;
+        }
+
+        float from[NUM_COEFS];
+        for (int i = 0; i < NUM_COEFS; ++i) from[i] = coef_[i];
+        cutoff_ = cutoff;
         calcCoefs();
+
+        float scale = 1.0f / static_cast<float>(numSamples);
+        for (int i = 0; i < NUM_COEFS; ++i) {
+            delta_[i] = (coef_[i] - from[i]) * scale;
+            coef_[i] = from[i];
+        }
     }
 
     void process(float input) {
-        // Direct Form II Transposed biquad
-        output_ = b0_ * input + z1_;
-        z1_ = b1_ * input - a1_ * output_ + z2_;
-        z2_ = b2_ * input - a2_ * output_;
+        for (int i = 0; i < NUM_COEFS; ++i) coef_[i] += delta_[i];
+
+        if (topology_ == BIQUAD) {
+            // Direct Form II Transposed biquad
+            output_ = coef_[0] * input + s1_;
+            s1_ = coef_[1] * input - coef_[3] * output_ + s2_;
+            s2_ = coef_[2] * input - coef_[4] * output_;
+        } else {
+            // s1, s2: band-pass and low-pass integrator states
+            float v3 = input - s2_;
+            float v1 = coef_[0] * s1_ + coef_[1] * v3;
+            float v2 = s2_ + coef_[1] * s1_ + coef_[2] * v3;
+            s1_ = 2.0f * v1 - s1_;
+            s2_ = 2.0f * v2 - s2_;
+            output_ = v2 + coef_[3] * (input - 2.0f * v2) + coef_[4] * v1;
+        }
     }
 
     float getOutput() const { return output_; }
     Type getType() const { return type_; }
+    Topology getTopology() const { return topology_; }
     float getCutoff() const { return cutoff_; }
     float getResonance() const { return resonance_; }
 
     void reset() {
-        z1_ = z2_ = 0.0f;
+        s1_ = s2_ = 0.0f;
         output_ = 0.0f;
     }
 
 private:
+    friend class VoiceBank;
+
+    bool isRamping() const {
+        for (int i = 0; i < NUM_COEFS; ++i) {
+            if (delta_[i] != 0.0f) return true;
+        }
+        return false;
+    }
+
+    // Recompute the coefficients for the current settings and stop any ramp
     void calcCoefs() {
-        float maxCutoff = sampleRate_ * 0.499f;
-        float fc = clampf(cutoff_, 20.0f, maxCutoff);
+        FMG_TRACE_SCOPE("Filter::calcCoefs");
+        dirty_ = false;
+        for (int i = 0; i < NUM_COEFS; ++i) delta_[i] = 0.0f;
 
-        float wc = 2.0f * 3.14159265359f * fc / sampleRate_;
-        float sinW = std::sin(wc);
-        float cosW = std::cos(wc);
+        float K = CutoffTable::lookup(cutoff_ / sampleRate_);
 
         // Q: resonance 0 = 0.707 (Butterworth), resonance 1 = Q of 12
         float Q = 0.707f + resonance_ * 11.293f;
-        float alpha = sinW / (2.0f * Q);
-
-        float a0;
-        if (type_ == LOWPASS) {
-            b0_ = (1.0f - cosW) * 0.5f;
-            b1_ = 1.0f - cosW;
-            b2_ = (1.0f - cosW) * 0.5f;
-            a0 = 1.0f + alpha;
-            a1_ = -2.0f * cosW;
-            a2_ = 1.0f - alpha;
+        float k = 1.0f / Q;
+
+        if (topology_ == BIQUAD) {
+            // Cookbook coefficients rewritten in terms of K, already normalized by a0
+            float norm = 1.0f / (1.0f + K * k + K * K);
+            if (type_ == LOWPASS) {
+                coef_[0] = K * K * norm;
+                coef_[1] = 2.0f * coef_[0];
+                coef_[2] = coef_[0];
+            } else {
+                coef_[0] = norm;
+                coef_[1] = -2.0f * norm;
+                coef_[2] = norm;
+            }
+            coef_[3] = 2.0f * (K * K - 1.0f) * norm;
+            coef_[4] = (1.0f - K * k + K * K) * norm;
         } else {
-            b0_ = (1.0f + cosW) * 0.5f;
-            b1_ = -(1.0f + cosW);
-            b2_ = (1.0f + cosW) * 0.5f;
-            a0 = 1.0f + alpha;
-            a1_ = -2.0f * cosW;
-            a2_ = 1.0f - alpha;
+            coef_[0] = 1.0f / (1.0f + K * (K + k));
+            coef_[1] = K * coef_[0];
+            coef_[2] = K * coef_[1];
+            coef_[3] = (type_ == LOWPASS) ? 0.0f : 1.0f;
+            coef_[4] = (type_ == LOWPASS) ? 0.0f : -k;
         }
-
-        // Normalize by a0
-        b0_ /= a0;
-        b1_ /= a0;
-        b2_ /= a0;
-        a1_ /= a0;
-        a2_ /= a0;
     }
 
     static inline float clampf(float v, float lo, float hi) {
@@ -93,17 +166,19 @@ private:
     }
 
     Type type_;
+    Topology topology_;
     float cutoff_;
     float resonance_;
     float sampleRate_;
     float output_;
 
-    // Biquad coefficients
-    float b0_, b1_, b2_;
-    float a1_, a2_;
+    float coef_[NUM_COEFS];
+    // Per-sample coefficient increments while ramping
+    float delta_[NUM_COEFS] = {};
 
-    // State (Direct Form II Transposed)
-    float z1_, z2_;
+    // State: DF2T delays (biquad) or integrator states (SVF)
+    float s1_, s2_;
+    bool dirty_ = false;   // a setting changed since calcCoefs()
 };
 
 #endif
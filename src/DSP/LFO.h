@@ -1,8 +1,11 @@
 #ifndef LFO_H
 #define LFO_H
 
+#include "QuadratureOscillator.h"
 #include <cmath>
 
+// Sine is generated by a quadrature rotator kept in step with phase_; the other
+// waves are evaluated from phase_.
 class LFO {
 public:
     enum Wave { WAVE_SINE, WAVE_SAW, WAVE_SQUARE, WAVE_TRIANGLE };
@@ -10,6 +13,7 @@ public:
     LFO() : rate_(1.0f), depth_(0.0f), phase_(0.0f), output_(0.0f),
              wave_(WAVE_SINE), sync_(true), sampleRate_(48000.0f) {
         updateIncrement();
+        sine_.setPhase(0.0f);
     }
 
     void setRate(float rate) {
@@ -21,8 +25,12 @@ public:
         depth_ = clamp(depth, 0.0f, 1.0f);
     }
 
-    void setWave(Wave wave) { wave_ = wave; }
-    void setWave(int wave) { wave_ = static_cast<Wave>(clamp(wave, 0, 3)); }
+    void setWave(Wave wave) {
+        // The rotator only runs for the sine wave: pick up the phase on switching to it
+        if (wave == WAVE_SINE && wave_ != WAVE_SINE) sine_.setPhase(phase_);
+        wave_ = wave;
+    }
+    void setWave(int wave) { setWave(static_cast<Wave>(clamp(wave, 0, 3))); }
 
     void setSync(bool sync) { sync_ = sync; }
 
@@ -34,28 +42,33 @@ public:
     void setPhase(float phase) {
         phase_ = fmod(phase, 1.0f);
         if (phase_ < 0) phase_ += 1.0f;
+        sine_.setPhase(phase_);
     }
 
     void process() {
-        switch (wave_) {
-            case WAVE_SINE:
-                output_ = sin(phase_ * 6.28318530718f);
-                break;
-            case WAVE_SAW:
-                output_ = 2.0f * phase_ - 1.0f;
-                break;
-            case WAVE_SQUARE:
-                output_ = (phase_ < 0.5f) ? 1.0f : -1.0f;
-                break;
-            case WAVE_TRIANGLE:
-                output_ = (phase_ < 0.5f) ? (4.0f * phase_ - 1.0f) : (3.0f - 4.0f * phase_);
-                break;
+        if (wave_ == WAVE_SINE) {
+            output_ = sine_.sine();
+            sine_.step();
+        } else {
+            output_ = evaluate(phase_);
         }
 
         phase_ += increment_;
         if (phase_ >= 1.0f) phase_ -= 1.0f;
     }
 
+    // Control-rate step: move numSamples ahead and evaluate the LFO there
+    void advance(int numSamples) {
+        phase_ += increment_ * static_cast<float>(numSamples);
+        phase_ -= std::floor(phase_);
+        if (wave_ == WAVE_SINE) {
+            sine_.advance(numSamples);
+            output_ = sine_.sine();
+        } else {
+            output_ = evaluate(phase_);
+        }
+    }
+
     float getOutput() const { return depth_ * output_; }
     float getRawOutput() const { return output_; }
     float getRate() const { return rate_; }
@@ -65,11 +78,27 @@ public:
     void reset() {
         phase_ = 0.0f;
         output_ = 0.0f;
+        sine_.setPhase(0.0f);
     }
 
 private:
+    float evaluate(float phase) const {
+        switch (wave_) {
+            case WAVE_SINE:
+                return sin(phase * 6.28318530718f);
+            case WAVE_SAW:
+                return 2.0f * phase - 1.0f;
+            case WAVE_SQUARE:
+                return (phase < 0.5f) ? 1.0f : -1.0f;
+            case WAVE_TRIANGLE:
+                return (phase < 0.5f) ? (4.0f * phase - 1.0f) : (3.0f - 4.0f * phase);
+        }
+        return 0.0f;
+    }
+
     void updateIncrement() {
         increment_ = rate_ / sampleRate_;
+        sine_.setIncrement(increment_);
     }
 
     static inline float clamp(float v, float lo, float hi) {
@@ -84,6 +113,7 @@ private:
     Wave wave_;
     bool sync_;
     float sampleRate_;
+    QuadratureOscillator sine_;
 };
 
 #endif
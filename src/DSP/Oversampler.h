@@ -1,74 +1,336 @@
 #pragma once
 
-#include "Constants.h"
-#include <vector>
+#include "Simd.h"
+#include "DenormalGuard.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
 
-enum class OversampleMode { Off, x2, x4 };
+// Auto picks 1x, 2x or 4x per voice from its estimated bandwidth
+enum class OversampleMode { Off, x2, x4, Auto };
+enum class OversampleFilter { FIR, IIR };
 
-template<typename T>
+// Halfband decimators: each halves the sample rate, keeping 0..0.21 of the input
+// rate and rejecting everything above 0.29 that would alias into it.
+
+// Linear-phase 63-tap halfband FIR (Kaiser window, beta 8, -71 dB), run as two
+// polyphase branches. Every other tap is zero and the centre tap is 0.5, so the odd
+// input samples only need a delay and the even ones a 32-tap symmetric FIR at the
+// output rate. The FIR is vectorized across output samples.
+class HalfbandFir {
+public:
+    static constexpr int TAPS = 32;                 // even-branch taps
+    static constexpr int ODD_DELAY = TAPS / 2;      // odd-branch delay (output samples)
+    static constexpr int MAX_OUTPUT = 512;          // per call
+    static constexpr float LATENCY = (TAPS - 1) / 2.0f;      // output samples
+
+    HalfbandFir() { reset(); }
+
+    void reset() {
+        std::fill(even_, even_ + TAPS - 1, 0.0f);
+        std::fill(odd_, odd_ + ODD_DELAY, 0.0f);
+    }
+
+    // in holds 2 * numOutput samples; out must be SIMD-aligned
+    void process(const float* in, float* out, int numOutput);
+
+private:
+    struct Coefs {
+        float g[TAPS];
+        Coefs();
+    };
+    static inline const Coefs coefs_{};
+
+    // Deinterleaved branches, each with its history in front
+    float even_[TAPS - 1 + MAX_OUTPUT];
+    float odd_[ODD_DELAY + MAX_OUTPUT];
+};
+
+// Polyphase IIR halfband: two chains of first-order allpasses at the output rate,
+// coefficients from the elliptic design of Valenzuela and Constantinides (as in
+// HIIR). Below -120 dB in the stopband with a latency of about two samples, at the
+// cost of phase distortion near the top of the passband.
+class HalfbandIir {
+public:
+    static constexpr int NUM_COEFS = 12;
+
+    HalfbandIir() { reset(); }
+
+    void reset() {
+        std::fill(x_, x_ + NUM_COEFS, 0.0f);
+        std::fill(y_, y_ + NUM_COEFS, 0.0f);
+    }
+
+    void process(const float* in, float* out, int numOutput) {
+        const float* c = coefs_.c;
+        for (int m = 0; m < numOutput; ++m) {
+            float a = in[2 * m + 1];
+            float b = in[2 * m];
+            for (int i = 0; i < NUM_COEFS; i += 2) {
+                float ya = (a - y_[i]) * c[i] + x_[i];
+                float yb = (b - y_[i + 1]) * c[i + 1] + x_[i + 1];
+                x_[i] = a;
+                x_[i + 1] = b;
+                y_[i] = ya;
+                y_[i + 1] = yb;
+                a = ya;
+                b = yb;
+            }
+            out[m] = 0.5f * (a + b);
+        }
+        for (int i = 0; i < NUM_COEFS; ++i) {
+            x_[i] = flushDenormal(x_[i]);
+            y_[i] = flushDenormal(y_[i]);
+        }
+    }
+
+    // Group delay at DC, in output samples
+    static float latency() { return coefs_.latency; }
+
+private:
+    struct Coefs {
+        float c[NUM_COEFS];
+        float latency;
+        Coefs();
+    };
+    static inline const Coefs coefs_{};
+
+    float x_[NUM_COEFS];
+    float y_[NUM_COEFS];
+};
+
+// Brings the voice mix down to the output rate. Voices render into one of three
+// buses, at 1x, 2x and 4x the output rate; bus[i] holds numOutput << i samples. Each
+// factor of two goes through a halfband stage, all FIR or all IIR. In Auto mode every
+// bus can carry voices, so the 1x and 2x buses are delayed to line up with the
+// decimated 4x bus (to within a quarter sample). Buffers are sized for MAX_OUTPUT
+// output-rate samples per call, so nothing is allocated while running.
 class Oversampler {
 public:
-    Oversampler() : mode_(OversampleMode::Off), ratio_(1), upBuffer_(0), downBuffer_(0) {}
-    
+    static constexpr int NUM_BUSES = 3;
+    static constexpr int MAX_OUTPUT = 256;   // per call, output rate
+
+    Oversampler() : mode_(OversampleMode::Off), filter_(OversampleFilter::FIR), ratio_(1) {
+        reset();
+    }
+
     void setMode(OversampleMode mode) {
         mode_ = mode;
         switch (mode) {
             case OversampleMode::x2: ratio_ = 2; break;
-            case OversampleMode::x4: ratio_ = 4; break;
+            case OversampleMode::x4:
+            case OversampleMode::Auto: ratio_ = 4; break;
             default: ratio_ = 1; break;
         }
+        reset();
+    }
+    void setFilter(OversampleFilter filter) {
+        filter_ = filter;
+        reset();
     }
-    
+
     OversampleMode getMode() const { return mode_; }
+    OversampleFilter getFilter() const { return filter_; }
+    // Highest voice rate, as a multiple of the output rate
     int getRatio() const { return ratio_; }
     bool isActive() const { return mode_ != OversampleMode::Off; }
-    
-    void process(T* input, T* output, int numSamples, void (*processFunc)(T*, T*, int)) {
-        if (mode_ == OversampleMode::Off) {
-            processFunc(input, output, numSamples);
-            return;
+
+    // Whether voices may render into bus (0 = 1x, 1 = 2x, 2 = 4x) in this mode
+    bool usesBus(int bus) const {
+        return mode_ == OversampleMode::Auto || (1 << bus) == ratio_;
+    }
+
+    void reset() {
+        for (int i = 0; i < 2; ++i) {
+            fir_[i].reset();
+            iir_[i].reset();
+        }
+        for (Delay& delay : delays_) delay = Delay();
+        float stage = stageLatency(filter_);
+        delays_[0].length = static_cast<int>(std::lround(stage * 1.5f));
+        delays_[1].length = static_cast<int>(std::lround(stage));
+    }
+
+    // Mix the buses down into bus[0] (numOutput samples). The buses this mode uses
+    // are overwritten; bus[0] must be SIMD-aligned.
+    void mixDown(float* const bus[NUM_BUSES], int numOutput) {
+        FMG_TRACE_SCOPE("Oversampler::mixDown");
+        switch (mode_) {
+            case OversampleMode::x2:
+                stage(1, bus[1], bus[0], numOutput);
+                break;
+            case OversampleMode::x4:
+                stage(0, bus[2], stageBuffer_, numOutput * 2);
+                stage(1, stageBuffer_, bus[0], numOutput);
+                break;
+            case OversampleMode::Auto:
+                stage(0, bus[2], stageBuffer_, numOutput * 2);
+                delays_[1].process(bus[1], numOutput * 2);
+                for (int i = 0; i < numOutput * 2; ++i) stageBuffer_[i] += bus[1][i];
+                stage(1, stageBuffer_, outBuffer_, numOutput);
+                delays_[0].process(bus[0], numOutput);
+                for (int i = 0; i < numOutput; ++i) bus[0][i] += outBuffer_[i];
+                break;
+            default:
+                break;
         }
-        
-        int upsampledSize = numSamples * ratio_;
-        upBuffer_.resize(upsampledSize);
-        downBuffer_.resize(upsampledSize);
-        
-        upsample(input, upBuffer_.data(), numSamples);
-        processFunc(upBuffer_.data(), downBuffer_.data(), upsampledSize);
-        downsample(downBuffer_.data(), output, numSamples);
-    }
-    
+    }
+
+    // Delay added by the decimation, in output samples
+    float getLatency() const { return latencyFor(mode_, filter_); }
+
+    static float latencyFor(OversampleMode mode, OversampleFilter filter) {
+        float stage = stageLatency(filter);
+        switch (mode) {
+            case OversampleMode::x2: return stage;
+            case OversampleMode::x4: return stage * 1.5f;  // first stage runs at 2x
+            case OversampleMode::Auto: return std::round(stage * 1.5f);
+            default: return 0.0f;
+        }
+    }
+
 private:
-    void upsample(T* input, T* output, int numSamples) {
-        if (ratio_ == 2) {
-            for (int i = 0; i < numSamples; i++) {
-                output[i * 2] = input[i];
-                output[i * 2 + 1] = input[i] * 0.5f;
-            }
-        } else if (ratio_ == 4) {
-            for (int i = 0; i < numSamples; i++) {
-                output[i * 4] = input[i];
-                output[i * 4 + 1] = input[i] * 0.66f;
-                output[i * 4 + 2] = input[i] * 0.33f;
-                output[i * 4 + 3] = 0.0f;
-            }
+    // One stage's delay in its own output samples
+    static float stageLatency(OversampleFilter filter) {
+        return (filter == OversampleFilter::FIR) ? HalfbandFir::LATENCY : HalfbandIir::latency();
+    }
+
+    // Stage 0 decimates 4x -> 2x, stage 1 decimates 2x -> 1x
+    void stage(int index, const float* in, float* out, int numOutput) {
+        if (filter_ == OversampleFilter::FIR) {
+            fir_[index].process(in, out, numOutput);
+        } else {
+            iir_[index].process(in, out, numOutput);
         }
     }
-    
-    void downsample(T* input, T* output, int numSamples) {
-        if (ratio_ == 2) {
-            for (int i = 0; i < numSamples; i++) {
-                output[i] = (input[i * 2] + input[i * 2 + 1]) * 0.5f;
-            }
-        } else if (ratio_ == 4) {
-            for (int i = 0; i < numSamples; i++) {
-                output[i] = (input[i * 4] + input[i * 4 + 1] + input[i * 4 + 2] + input[i * 4 + 3]) * 0.25f;
+
+    // In-place integer delay for lining up a bus
+    struct Delay {
+        static constexpr int SIZE = 32;
+        float buffer[SIZE] = {};
+        int pos = 0;
+        int length = 0;
+
+        void process(float* x, int numSamples) {
+            for (int i = 0; i < numSamples; ++i) {
+                buffer[pos] = x[i];
+                x[i] = buffer[(pos - length) & (SIZE - 1)];
+                pos = (pos + 1) & (SIZE - 1);
             }
         }
-    }
-    
+    };
+
     OversampleMode mode_;
+    OversampleFilter filter_;
     int ratio_;
-    std::vector<T> upBuffer_;
-    std::vector<T> downBuffer_;
+
+    HalfbandFir fir_[2];
+    HalfbandIir iir_[2];
+    Delay delays_[2];   // for the 1x and 2x buses in Auto mode
+
+    // Stage 0 output (2x rate) and stage 1 output in Auto mode
+    alignas(64) float stageBuffer_[2 * MAX_OUTPUT];
+    alignas(64) float outBuffer_[MAX_OUTPUT];
+    static_assert(2 * MAX_OUTPUT <= HalfbandFir::MAX_OUTPUT, "FIR stage buffers too small");
 };
+
+inline void HalfbandFir::process(const float* in, float* out, int numOutput) {
+    // e[m - k] and odd_[m] line up with out[m]
+    float* e = even_ + TAPS - 1;
+    for (int m = 0; m < numOutput; ++m) {
+        e[m] = in[2 * m];
+        odd_[ODD_DELAY + m] = in[2 * m + 1];
+    }
+
+    const float* g = coefs_.g;
+    int m = 0;
+    for (; m + SIMD_WIDTH <= numOutput; m += SIMD_WIDTH) {
+        SimdFloat acc = simdLoadUnaligned(odd_ + m) * 0.5f;
+        for (int k = 0; k < TAPS / 2; ++k) {
+            SimdFloat pair = simdLoadUnaligned(e + m - k) +
+                             simdLoadUnaligned(e + m - (TAPS - 1 - k));
+            acc = acc + pair * g[k];
+        }
+        simdStore(out + m, acc);
+    }
+    for (; m < numOutput; ++m) {
+        float acc = odd_[m] * 0.5f;
+        for (int k = 0; k < TAPS / 2; ++k) {
+            acc += (e[m - k] + e[m - (TAPS - 1 - k)]) * g[k];
+        }
+        out[m] = acc;
+    }
+
+    std::copy(even_ + numOutput, even_ + numOutput + TAPS - 1, even_);
+    std::copy(odd_ + numOutput, odd_ + numOutput + ODD_DELAY, odd_);
+}
+
+// Kaiser-windowed halfband, h[n] = sin(pi n / 2) / (pi n) * w(n), keeping the taps at
+// odd n (the even branch) and normalizing them to a DC gain of 0.5
+inline HalfbandFir::Coefs::Coefs() {
+    const double pi = 3.14159265358979323846;
+    const double beta = 8.0;
+    auto besselI0 = [](double x) {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 50; ++k) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    };
+
+    const int half = TAPS - 1;   // (63 - 1) / 2
+    double taps[TAPS];
+    double sum = 0.0;
+    for (int k = 0; k < TAPS; ++k) {
+        int n = 2 * k - half;    // odd offsets -31 .. 31
+        double r = static_cast<double>(n) / half;
+        double w = besselI0(beta * std::sqrt(1.0 - r * r)) / besselI0(beta);
+        taps[k] = std::sin(pi * n / 2.0) / (pi * n) * w;
+        sum += taps[k];
+    }
+    for (int k = 0; k < TAPS; ++k) {
+        g[k] = static_cast<float>(taps[k] * 0.5 / sum);
+    }
+}
+
+// Coefficients for NUM_COEFS allpasses with a transition band of 0.04 (relative to
+// the input rate), following HIIR's PolyphaseIir2Designer
+inline HalfbandIir::Coefs::Coefs() {
+    const double pi = 3.14159265358979323846;
+    const double transition = 0.04;
+    const int order = NUM_COEFS * 2 + 1;
+
+    double k = std::tan((1.0 - transition * 2.0) * pi / 4.0);
+    k *= k;
+    double kksqrt = std::pow(1.0 - k * k, 0.25);
+    double e = 0.5 * (1.0 - kksqrt) / (1.0 + kksqrt);
+    double e4 = e * e * e * e;
+    double q = e * (1.0 + e4 * (2.0 + e4 * (15.0 + 150.0 * e4)));
+
+    double delay = 0.0;
+    for (int index = 0; index < NUM_COEFS; ++index) {
+        int c = index + 1;
+        double num = 0.0;
+        for (int i = 0, sign = 1;; ++i, sign = -sign) {
+            double t = std::pow(q, i * (i + 1)) * std::sin((i * 2 + 1) * c * pi / order) * sign;
+            num += t;
+            if (std::fabs(t) < 1e-100) break;
+        }
+        double den = 0.0;
+        for (int i = 1, sign = -1;; ++i, sign = -sign) {
+            double t = std::pow(q, i * i) * std::cos(i * 2 * c * pi / order) * sign;
+            den += t;
+            if (std::fabs(t) < 1e-100) break;
+        }
+        double ww = num * std::pow(q, 0.25) / (den + 0.5);
+        double wwsq = ww * ww;
+        double x = std::sqrt((1.0 - wwsq * k) * (1.0 - wwsq / k)) / (1.0 + wwsq);
+        double coef = (1.0 - x) / (1.0 + x);
+        this->c[index] = static_cast<float>(coef);
+        // Each allpass delays DC by (1 - a) / (1 + a) output samples
+        delay += (1.0 - coef) / (1.0 + coef);
+    }
+    // The two chains are averaged; the odd-sample chain starts half a sample later
+    latency = static_cast<float>(delay / 2.0 - 0.25);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+// What the audio thread reports about its recent blocks, for a DSP load display
+struct PerformanceStats {
+    float load = 0.0f;             // render time / real-time budget, mean over the window
+    float peakLoad = 0.0f;         // worst block in the window
+    int overruns = 0;              // blocks in the window that took longer than their budget
+    int activeVoices = 0;          // at the end of the window
+    float stealsPerSecond = 0.0f;
+    bool denormalsFlushed = false;
+    int oversampleRatio = 1;
+};
+
+// Block statistics from the audio thread to one reader (the editor), without locks
+// or allocation. The audio thread sums its blocks over WINDOW seconds of audio and
+// publishes the result through a triple buffer: it always writes a buffer the
+// reader cannot see and swaps it in with one atomic exchange, so neither side ever
+// waits. Metering is off until setEnabled(true); while off, the audio thread only
+// checks the flag.
+class PerformanceMeter {
+public:
+    static constexpr float WINDOW = 0.25f;   // seconds of audio per snapshot
+
+    // Any thread. Typically on while the editor is open.
+    void setEnabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+
+    // Audio thread, before a block: whether to time it. Starts a new window after a
+    // period with metering off.
+    bool shouldMeasure() {
+        bool enabled = enabled_.load(std::memory_order_relaxed);
+        if (!enabled) windowFrames_ = 0;
+        return enabled;
+    }
+
+    // Audio thread, after a timed block. totalSteals is a running count (wraps).
+    void addBlock(double renderSeconds, int numFrames, double sampleRate, int activeVoices,
+                  uint32_t totalSteals, bool denormalsFlushed, int oversampleRatio) {
+        if (numFrames <= 0 || sampleRate <= 0.0) return;
+        if (windowFrames_ == 0) {
+            windowSeconds_ = 0.0;
+            windowBudget_ = 0.0;
+            peakLoad_ = 0.0;
+            overruns_ = 0;
+            windowSteals_ = totalSteals;
+        }
+        double budget = numFrames / sampleRate;
+        windowSeconds_ += renderSeconds;
+        windowBudget_ += budget;
+        peakLoad_ = std::max(peakLoad_, renderSeconds / budget);
+        if (renderSeconds > budget) ++overruns_;
+        windowFrames_ += numFrames;
+        if (windowBudget_ < WINDOW) return;
+
+        PerformanceStats& stats = buffers_[back_];
+        stats.load = static_cast<float>(windowSeconds_ / windowBudget_);
+        stats.peakLoad = static_cast<float>(peakLoad_);
+        stats.overruns = overruns_;
+        stats.activeVoices = activeVoices;
+        stats.stealsPerSecond = static_cast<float>((totalSteals - windowSteals_) / windowBudget_);
+        stats.denormalsFlushed = denormalsFlushed;
+        stats.oversampleRatio = oversampleRatio;
+        back_ = middle_.exchange(static_cast<uint8_t>(back_ | FRESH), std::memory_order_acq_rel) & INDEX;
+        windowFrames_ = 0;
+    }
+
+    // Reader thread: the latest snapshot. Returns false if nothing new was published
+    // since the last call; stats then holds the previous one.
+    bool read(PerformanceStats& stats) {
+        bool fresh = (middle_.load(std::memory_order_relaxed) & FRESH) != 0;
+        if (fresh) front_ = middle_.exchange(static_cast<uint8_t>(front_), std::memory_order_acq_rel) & INDEX;
+        stats = buffers_[front_];
+        return fresh;
+    }
+
+private:
+    static constexpr uint8_t INDEX = 3;
+    static constexpr uint8_t FRESH = 4;
+
+    PerformanceStats buffers_[3];
+    std::atomic<uint8_t> middle_ {1};
+    std::atomic<bool> enabled_ {false};
+
+    // Audio thread only
+    int back_ = 0;
+    int64_t windowFrames_ = 0;
+    double windowSeconds_ = 0.0;
+    double windowBudget_ = 0.0;
+    double peakLoad_ = 0.0;
+    int overruns_ = 0;
+    uint32_t windowSteals_ = 0;
+
+    // Reader only
+    int front_ = 2;
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cmath>
+
+// cos/sin of an angle given in cycles: a point on the unit circle, also used as a
+// rotation by that angle
+struct Phasor {
+    float c = 1.0f;
+    float s = 0.0f;
+
+    static Phasor of(float cycles) {
+        float angle = cycles * 6.28318530718f;
+        return { std::cos(angle), std::sin(angle) };
+    }
+};
+
+// Sine/cosine oscillator as a complex rotator: each sample multiplies the current
+// phasor by a fixed rotation, four multiply-adds instead of a sin() call. Rounding
+// makes the magnitude drift, so it is pulled back to 1 with one Newton step
+// (g = 1.5 - 0.5 * |z|^2) after every step() and at the end of every block.
+//
+// Phase is in cycles. An output at a fixed phase offset is a rotation of the
+// current phasor (sine(offset)); a quarter cycle ahead is simply cosine().
+class QuadratureOscillator {
+public:
+    // Frequency in cycles per sample
+    void setIncrement(float increment) {
+        increment_ = increment;
+        step_ = Phasor::of(increment);
+        strideSamples_ = 0;
+    }
+
+    void setPhase(float phase) { z_ = Phasor::of(phase); }
+
+    float sine() const { return z_.s; }
+    float cosine() const { return z_.c; }
+    // sin(phase + offset), for an offset made with Phasor::of
+    float sine(const Phasor& offset) const { return z_.s * offset.c + z_.c * offset.s; }
+
+    void step() {
+        z_ = rotate(z_, step_);
+        normalize();
+    }
+
+    // Move numSamples ahead in one rotation (control-rate use). The rotation is
+    // cached, so repeated strides of the same length cost no trig.
+    void advance(int numSamples) {
+        if (numSamples != strideSamples_) {
+            stride_ = Phasor::of(increment_ * static_cast<float>(numSamples));
+            strideSamples_ = numSamples;
+        }
+        z_ = rotate(z_, stride_);
+        normalize();
+    }
+
+    // Sine and cosine for the next numSamples samples; the oscillator ends
+    // numSamples ahead
+    void fill(float* sine, float* cosine, int numSamples) {
+        Phasor z = z_;
+        for (int s = 0; s < numSamples; ++s) {
+            sine[s] = z.s;
+            cosine[s] = z.c;
+            z = rotate(z, step_);
+        }
+        z_ = z;
+        normalize();
+    }
+
+    void fillSine(float* sine, int numSamples) {
+        Phasor z = z_;
+        for (int s = 0; s < numSamples; ++s) {
+            sine[s] = z.s;
+            z = rotate(z, step_);
+        }
+        z_ = z;
+        normalize();
+    }
+
+private:
+    static Phasor rotate(const Phasor& z, const Phasor& r) {
+        return { z.c * r.c - z.s * r.s, z.s * r.c + z.c * r.s };
+    }
+
+    void normalize() {
+        float g = 1.5f - 0.5f * (z_.c * z_.c + z_.s * z_.s);
+        z_.c *= g;
+        z_.s *= g;
+    }
+
+    Phasor z_;
+    Phasor step_;
+    Phasor stride_;
+    float increment_ = 0.0f;
+    int strideSamples_ = 0;
+};
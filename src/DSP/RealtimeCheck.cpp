@@ -0,0 +1,249 @@
+// RealtimeCheck.cpp - Allocation, lock and file I/O interception for real-time scopes
+#include "RealtimeCheck.h"
+
+#if defined(FMG_REALTIME_CHECK) && FMG_REALTIME_CHECK && !defined(_WIN32)
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* p);
+}
+#endif
+
+namespace {
+
+// Plain thread-locals with constant initialization: reading them never allocates
+thread_local int realtimeDepth = 0;
+thread_local int allowDepth = 0;
+thread_local bool reporting = false;
+
+std::atomic<int> violationCount {0};
+
+bool abortOnViolation() {
+    static const bool abort = [] {
+        const char* value = std::getenv("FMG_REALTIME_ABORT");
+        return value && value[0] == '1';
+    }();
+    return abort;
+}
+
+#if defined(__GLIBC__)
+// The real functions, looked up before main so that dlsym's own allocations
+// happen outside any real-time scope
+using WriteFn = ssize_t (*)(int, const void*, size_t);
+using ReadFn = ssize_t (*)(int, void*, size_t);
+using OpenFn = int (*)(const char*, int, ...);
+using FopenFn = FILE* (*)(const char*, const char*);
+using FreadFn = size_t (*)(void*, size_t, size_t, FILE*);
+using FwriteFn = size_t (*)(const void*, size_t, size_t, FILE*);
+using MutexLockFn = int (*)(pthread_mutex_t*);
+
+WriteFn realWrite;
+ReadFn realRead;
+OpenFn realOpen;
+FopenFn realFopen;
+FreadFn realFread;
+FwriteFn realFwrite;
+MutexLockFn realMutexLock;
+
+// Looks a function up on first use too, for calls made by other static initializers
+template<typename Fn>
+Fn next(Fn& fn, const char* name) {
+    if (!fn) fn = reinterpret_cast<Fn>(dlsym(RTLD_NEXT, name));
+    return fn;
+}
+
+__attribute__((constructor)) void resolveRealFunctions() {
+    next(realWrite, "write");
+    next(realRead, "read");
+    next(realOpen, "open");
+    next(realFopen, "fopen");
+    next(realFread, "fread");
+    next(realFwrite, "fwrite");
+    next(realMutexLock, "pthread_mutex_lock");
+    // backtrace() loads its unwinder on first use; do that here as well
+    void* frame;
+    backtrace(&frame, 1);
+}
+
+void* rawMalloc(size_t size) { return __libc_malloc(size); }
+void* rawAligned(size_t alignment, size_t size) { return __libc_memalign(alignment, size); }
+void rawFree(void* p) { __libc_free(p); }
+#else
+__attribute__((constructor)) void preloadBacktrace() {
+    void* frame;
+    backtrace(&frame, 1);
+}
+
+void* rawMalloc(size_t size) { return std::malloc(size); }
+void* rawAligned(size_t alignment, size_t size) {
+    void* p = nullptr;
+    return (posix_memalign(&p, alignment, size) == 0) ? p : nullptr;
+}
+void rawFree(void* p) { std::free(p); }
+#endif
+
+void report(const char* what) {
+    reporting = true;
+    violationCount.fetch_add(1, std::memory_order_relaxed);
+
+    char line[160];
+    int length = std::snprintf(line, sizeof(line), "realtime violation: %s in a real-time scope\n", what);
+    ::write(STDERR_FILENO, line, static_cast<size_t>(length));
+    void* frames[32];
+    int numFrames = backtrace(frames, 32);
+    backtrace_symbols_fd(frames + 2, numFrames - 2, STDERR_FILENO);   // skip check() and report()
+
+    if (abortOnViolation()) std::abort();
+    reporting = false;
+}
+
+inline void check(const char* what) {
+    if (realtimeDepth > 0 && allowDepth == 0 && !reporting) report(what);
+}
+
+}
+
+namespace RealtimeCheck {
+
+int getViolationCount() { return violationCount.load(std::memory_order_relaxed); }
+
+Scope::Scope() { ++realtimeDepth; }
+Scope::~Scope() { --realtimeDepth; }
+Allow::Allow() { ++allowDepth; }
+Allow::~Allow() { --allowDepth; }
+
+}
+
+// operator new/delete, every form
+void* operator new(size_t size) {
+    check("operator new");
+    if (void* p = rawMalloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) {
+    check("operator new[]");
+    if (void* p = rawMalloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    check("operator new");
+    return rawMalloc(size ? size : 1);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    check("operator new[]");
+    return rawMalloc(size ? size : 1);
+}
+void* operator new(size_t size, std::align_val_t alignment) {
+    check("operator new (aligned)");
+    if (void* p = rawAligned(static_cast<size_t>(alignment), size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+    check("operator new[] (aligned)");
+    if (void* p = rawAligned(static_cast<size_t>(alignment), size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept {
+    if (p) check("operator delete");
+    rawFree(p);
+}
+void operator delete[](void* p) noexcept {
+    if (p) check("operator delete[]");
+    rawFree(p);
+}
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, size_t) noexcept { operator delete[](p); }
+void operator delete(void* p, std::align_val_t) noexcept { operator delete(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { operator delete[](p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { operator delete(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { operator delete[](p); }
+
+#if defined(__GLIBC__)
+// C allocation, locks and file I/O
+extern "C" {
+
+void* malloc(size_t size) {
+    check("malloc");
+    return __libc_malloc(size);
+}
+void* calloc(size_t count, size_t size) {
+    check("calloc");
+    return __libc_calloc(count, size);
+}
+void* realloc(void* p, size_t size) {
+    check("realloc");
+    return __libc_realloc(p, size);
+}
+void free(void* p) {
+    if (p) check("free");
+    __libc_free(p);
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) {
+    check("pthread_mutex_lock");
+    return next(realMutexLock, "pthread_mutex_lock")(mutex);
+}
+
+int open(const char* path, int flags, ...) {
+    check("open");
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list args;
+        va_start(args, flags);
+        mode = static_cast<mode_t>(va_arg(args, int));
+        va_end(args);
+    }
+    return next(realOpen, "open")(path, flags, mode);
+}
+ssize_t read(int fd, void* buffer, size_t size) {
+    check("read");
+    return next(realRead, "read")(fd, buffer, size);
+}
+ssize_t write(int fd, const void* buffer, size_t size) {
+    check("write");
+    return next(realWrite, "write")(fd, buffer, size);
+}
+FILE* fopen(const char* path, const char* mode) {
+    check("fopen");
+    return next(realFopen, "fopen")(path, mode);
+}
+size_t fread(void* buffer, size_t size, size_t count, FILE* file) {
+    check("fread");
+    return next(realFread, "fread")(buffer, size, count, file);
+}
+size_t fwrite(const void* buffer, size_t size, size_t count, FILE* file) {
+    check("fwrite");
+    return next(realFwrite, "fwrite")(buffer, size, count, file);
+}
+
+}
+#endif
+
+#elif defined(FMG_REALTIME_CHECK) && FMG_REALTIME_CHECK
+
+// No interception on Windows: scopes are counted but nothing is reported
+namespace RealtimeCheck {
+int getViolationCount() { return 0; }
+Scope::Scope() {}
+Scope::~Scope() {}
+Allow::Allow() {}
+Allow::~Allow() {}
+}
+
+#endif
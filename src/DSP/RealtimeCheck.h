@@ -0,0 +1,63 @@
+#pragma once
+
+// Debug check that the audio thread never allocates, locks or touches files.
+//
+//   FMG_REALTIME_SCOPE()  the calling thread is real-time until the scope ends
+//   FMG_REALTIME_ALLOW()  suspend the check until the scope ends (deliberate,
+//                         one-time work such as a trace buffer)
+//
+// Compiled in only when FMG_REALTIME_CHECK is defined to 1 (CMake option
+// FREQMODGRID_REALTIME_CHECK); otherwise the macros expand to nothing. When on,
+// RealtimeCheck.cpp replaces operator new/delete and, on glibc, interposes
+// malloc/free, pthread_mutex_lock and the open/read/write/fopen/fread/fwrite
+// calls. Each call made inside a real-time scope is reported on stderr with a
+// backtrace. With the environment variable FMG_REALTIME_ABORT=1 the first one
+// aborts instead.
+//
+// Interposition replaces the process-wide symbols, so it works when the check is
+// linked into an executable (the offline renderer, benchmarks, a standalone
+// build), not in a plugin loaded by a host, which keeps the host's allocator.
+
+#if defined(FMG_REALTIME_CHECK) && FMG_REALTIME_CHECK
+
+namespace RealtimeCheck {
+
+constexpr bool ENABLED = true;
+
+// Number of violations reported so far, on any thread
+int getViolationCount();
+
+class Scope {
+public:
+    Scope();
+    ~Scope();
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+};
+
+class Allow {
+public:
+    Allow();
+    ~Allow();
+    Allow(const Allow&) = delete;
+    Allow& operator=(const Allow&) = delete;
+};
+
+}
+
+#define FMG_REALTIME_CONCAT2(a, b) a##b
+#define FMG_REALTIME_CONCAT(a, b) FMG_REALTIME_CONCAT2(a, b)
+#define FMG_REALTIME_SCOPE() ::RealtimeCheck::Scope FMG_REALTIME_CONCAT(realtimeScope_, __LINE__)
+#define FMG_REALTIME_ALLOW() ::RealtimeCheck::Allow FMG_REALTIME_CONCAT(realtimeAllow_, __LINE__)
+
+#else
+
+namespace RealtimeCheck {
+constexpr bool ENABLED = false;
+inline int getViolationCount() { return 0; }
+}
+
+#define FMG_REALTIME_SCOPE() ((void)0)
+#define FMG_REALTIME_ALLOW() ((void)0)
+
+#endif
@@ -0,0 +1,201 @@
+// RenderThreadPool.cpp - Worker threads and job distribution for voice rendering
+#include "RenderThreadPool.h"
+#include "DenormalGuard.h"
+#include "Trace.h"
+#include "RealtimeCheck.h"
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#include <pthread/qos.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define RENDER_POOL_PAUSE() _mm_pause()
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define RENDER_POOL_PAUSE() asm volatile("yield")
+#else
+#define RENDER_POOL_PAUSE() ((void)0)
+#endif
+
+namespace {
+// Iterations a worker keeps polling for the next job before it goes to sleep
+const int IDLE_SPIN_COUNT = 4000;
+// Pools with workers running, across every instance in the process
+std::atomic<int> livePools{0};
+}
+
+void RenderThreadPool::start(int numWorkers) {
+    stop();
+
+    numWorkers = std::max(0, std::min(numWorkers, MAX_THREADS - 1));
+    stopping_.store(false, std::memory_order_relaxed);
+    if (numWorkers == 0) return;
+
+    livePools.fetch_add(1, std::memory_order_relaxed);
+    workers_.reserve(numWorkers);
+    for (int i = 0; i < numWorkers; ++i) {
+        workers_.emplace_back(&RenderThreadPool::workerLoop, this, i + 1);
+    }
+}
+
+void RenderThreadPool::stop() {
+    if (workers_.empty()) return;
+
+    stopping_.store(true, std::memory_order_relaxed);
+    job_.fetch_add(1, std::memory_order_release);
+    job_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+    livePools.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void RenderThreadPool::run(Task task, void* context, int numItems, int maxThreads) {
+    numItems = std::min(numItems, MAX_ITEMS);
+    int numRanges = std::max(1, std::min({maxThreads, getNumWorkers() + 1, numItems}));
+
+    task_ = task;
+    context_ = context;
+    itemsDone_.store(0, std::memory_order_relaxed);
+    numRanges_.store(numRanges, std::memory_order_relaxed);
+
+    uint32_t job = job_.load(std::memory_order_relaxed) + 1;
+    for (int r = 0; r < numRanges; ++r) {
+        int begin = numItems * r / numRanges;
+        int end = numItems * (r + 1) / numRanges;
+        ranges_[r].cursor.store(packRange(job, begin, end), std::memory_order_release);
+    }
+
+    if (numRanges > 1) {
+        job_.store(job, std::memory_order_release);
+        job_.notify_all();
+    } else {
+        job_.store(job, std::memory_order_relaxed);
+    }
+
+    participate(job, 0);
+
+    // Join: everything is claimed, wait for items still in flight on workers
+    while (itemsDone_.load(std::memory_order_acquire) < numItems) {
+        RENDER_POOL_PAUSE();
+    }
+}
+
+void RenderThreadPool::participate(uint32_t job, int thread) {
+    FMG_REALTIME_SCOPE();
+    FMG_TRACE_SCOPE("RenderThreadPool::participate");
+    int numRanges = numRanges_.load(std::memory_order_relaxed);
+    int own = (thread < numRanges) ? thread : 0;
+
+    for (int i = 0; i < numRanges; ++i) {
+        int range = (own + i) % numRanges;
+        int item;
+        while (claim(job, range, item)) {
+            task_(context_, item, thread);
+            itemsDone_.fetch_add(1, std::memory_order_release);
+        }
+    }
+}
+
+bool RenderThreadPool::claim(uint32_t job, int range, int& item) {
+    uint64_t cursor = ranges_[range].cursor.load(std::memory_order_acquire);
+    for (;;) {
+        int next = static_cast<int>((cursor >> 16) & 0xFFFF);
+        int end = static_cast<int>(cursor & 0xFFFF);
+        if (static_cast<uint32_t>(cursor >> 32) != job || next >= end) return false;
+
+        if (ranges_[range].cursor.compare_exchange_weak(cursor, cursor + (1u << 16),
+                                                        std::memory_order_acq_rel,
+                                                        std::memory_order_acquire)) {
+            item = next;
+            return true;
+        }
+    }
+}
+
+void RenderThreadPool::workerLoop(int thread) {
+    configureWorkerThread();
+    DenormalGuard denormalGuard;   // for the life of the thread
+    FMG_TRACE_THREAD("render worker");
+
+    bool pinned = false;
+    uint32_t seen = job_.load(std::memory_order_acquire);
+    for (;;) {
+        uint32_t job = job_.load(std::memory_order_acquire);
+        for (int spin = 0; job == seen && spin < IDLE_SPIN_COUNT; ++spin) {
+            RENDER_POOL_PAUSE();
+            job = job_.load(std::memory_order_acquire);
+        }
+        if (job == seen) {
+            job_.wait(seen, std::memory_order_acquire);
+            continue;
+        }
+
+        seen = job;
+        if (stopping_.load(std::memory_order_relaxed)) return;
+        // Pools come and go with plugin instances; follow the count between jobs
+        bool pin = livePools.load(std::memory_order_relaxed) == 1;
+        if (pin != pinned) {
+            pinWorkerThread(thread, pin);
+            pinned = pin;
+        }
+        participate(job, thread);
+    }
+}
+
+void RenderThreadPool::configureWorkerThread() {
+#if defined(_WIN32)
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#elif defined(__APPLE__)
+    // macOS has no hard affinity; ask for the highest-priority QoS class instead
+    pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+#else
+    // Needs CAP_SYS_NICE or an rtprio limit; otherwise stays at normal priority
+    sched_param param{};
+    param.sched_priority = std::max(sched_get_priority_min(SCHED_FIFO),
+                                    sched_get_priority_max(SCHED_FIFO) - 10);
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+#endif
+}
+
+void RenderThreadPool::pinWorkerThread(int thread, bool pin) {
+    unsigned numCores = std::max(1u, std::thread::hardware_concurrency());
+    // Core 0 is left to the host's audio thread
+    unsigned core = static_cast<unsigned>(thread) % numCores;
+
+#if defined(_WIN32)
+    DWORD_PTR processMask, systemMask;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask)) return;
+    if (pin && numCores < 64) {
+        SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core);
+    } else {
+        SetThreadAffinityMask(GetCurrentThread(), processMask);
+    }
+#elif defined(__APPLE__)
+    (void)core;
+    (void)pin;
+#else
+    // The cores the thread was started with, to return to when unpinned
+    thread_local cpu_set_t startCpus;
+    thread_local bool haveStartCpus = false;
+    if (!haveStartCpus) {
+        haveStartCpus = pthread_getaffinity_np(pthread_self(), sizeof(startCpus), &startCpus) == 0;
+        if (!haveStartCpus) return;
+    }
+
+    cpu_set_t cpus = startCpus;
+    if (pin) {
+        CPU_ZERO(&cpus);
+        CPU_SET(core, &cpus);
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#endif
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Pool of real-time render threads that share the items of one job with the
+// calling (audio) thread.
+//
+// run() splits the items into one contiguous range per participant. Each
+// participant claims items from its own range and, once that is empty, steals from
+// the others; a claim is a single compare-and-swap on the range's cursor, which also
+// carries the job number so a thread arriving late from an earlier job can never
+// take an item of the current one. Threads that have not woken up by the time their
+// range is stolen simply find nothing left, so the caller only ever waits for items
+// that are already being rendered. It spins for those rather than blocking.
+//
+// Workers are raised to real-time priority where the platform allows it (failures
+// are ignored). While this is the only pool with workers in the process they are
+// also pinned to their own cores; several plugin instances each running a pool would
+// otherwise pin their workers to the same cores, so with more than one pool the
+// workers are left to the scheduler. They spin briefly after each job and then sleep
+// on an atomic wait until the next one.
+class RenderThreadPool {
+public:
+    static constexpr int MAX_THREADS = 16;   // including the caller
+    static constexpr int MAX_ITEMS = 0xFFFF;
+
+    // item is in [0, numItems); thread is 0 for the caller, 1.. for workers
+    typedef void (*Task)(void* context, int item, int thread);
+
+    RenderThreadPool() = default;
+    ~RenderThreadPool() { stop(); }
+
+    RenderThreadPool(const RenderThreadPool&) = delete;
+    RenderThreadPool& operator=(const RenderThreadPool&) = delete;
+
+    // Start numWorkers threads (clamped to MAX_THREADS - 1), stopping any running
+    // ones first. Not real-time safe: call while no job is running.
+    void start(int numWorkers);
+    void stop();
+
+    int getNumWorkers() const { return static_cast<int>(workers_.size()); }
+
+    // Run task over numItems items on the caller and up to maxThreads - 1 workers;
+    // returns when every item has finished. Call from one thread at a time.
+    void run(Task task, void* context, int numItems, int maxThreads);
+
+private:
+    // Range cursor packing: job (32 bits) | next item (16) | end item (16)
+    static uint64_t packRange(uint32_t job, int next, int end) {
+        return (static_cast<uint64_t>(job) << 32) | (static_cast<uint64_t>(next) << 16) |
+               static_cast<uint64_t>(end);
+    }
+
+    void workerLoop(int thread);
+    // Claim and run items of job until none are left anywhere
+    void participate(uint32_t job, int thread);
+    bool claim(uint32_t job, int range, int& item);
+    static void configureWorkerThread();
+    // Pin the calling worker to its own core, or return it to the cores it started on
+    static void pinWorkerThread(int thread, bool pin);
+
+    struct alignas(64) Range {
+        std::atomic<uint64_t> cursor{0};
+    };
+
+    Range ranges_[MAX_THREADS];
+    std::atomic<uint32_t> job_{0};
+    std::atomic<int> numRanges_{0};
+    alignas(64) std::atomic<int> itemsDone_{0};
+    std::atomic<bool> stopping_{false};
+
+    // Written by run() before the job is published, read after a successful claim
+    Task task_ = nullptr;
+    void* context_ = nullptr;
+
+    std::vector<std::thread> workers_;
+};
@@ -0,0 +1,207 @@
+#pragma once
+
+// Thin wrapper over the SIMD instruction set selected at compile time. Used by the
+// voice bank kernels: AVX2 (8 lanes), SSE2 (4 lanes), or a portable 4-lane fallback
+// written as plain loops for the compiler to vectorize (e.g. NEON on Apple Silicon).
+//
+// Comparison results are lane masks and are only meant to be consumed by
+// simdAnd() and simdSelect().
+
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FMG_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FMG_SIMD_SSE2 1
+#endif
+
+#if defined(FMG_SIMD_AVX2)
+
+static const int SIMD_WIDTH = 8;
+static const bool SIMD_ACCELERATED = true;
+
+struct SimdFloat { __m256 v; };
+
+static inline SimdFloat simdLoad(const float* p) { return {_mm256_load_ps(p)}; }
+static inline SimdFloat simdLoadUnaligned(const float* p) { return {_mm256_loadu_ps(p)}; }
+static inline void simdStore(float* p, SimdFloat a) { _mm256_store_ps(p, a.v); }
+static inline SimdFloat simdSet(float x) { return {_mm256_set1_ps(x)}; }
+
+static inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return {_mm256_add_ps(a.v, b.v)}; }
+static inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return {_mm256_sub_ps(a.v, b.v)}; }
+static inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return {_mm256_mul_ps(a.v, b.v)}; }
+static inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return {_mm256_div_ps(a.v, b.v)}; }
+
+static inline SimdFloat simdFloor(SimdFloat a) { return {_mm256_floor_ps(a.v)}; }
+static inline SimdFloat simdGreater(SimdFloat a, SimdFloat b) {
+    return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)};
+}
+static inline SimdFloat simdGreaterEqual(SimdFloat a, SimdFloat b) {
+    return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)};
+}
+static inline SimdFloat simdAnd(SimdFloat mask, SimdFloat a) { return {_mm256_and_ps(mask.v, a.v)}; }
+static inline SimdFloat simdSelect(SimdFloat mask, SimdFloat a, SimdFloat b) {
+    return {_mm256_blendv_ps(b.v, a.v, mask.v)};
+}
+static inline SimdFloat simdRound(SimdFloat a) {
+    return {_mm256_round_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)};
+}
+
+// 32-bit integer lanes (fixed-point oscillator phases)
+struct SimdInt { __m256i v; };
+
+static inline SimdInt simdLoadInt(const int32_t* p) {
+    return {_mm256_load_si256(reinterpret_cast<const __m256i*>(p))};
+}
+static inline void simdStoreInt(int32_t* p, SimdInt a) {
+    _mm256_store_si256(reinterpret_cast<__m256i*>(p), a.v);
+}
+static inline SimdInt operator+(SimdInt a, SimdInt b) { return {_mm256_add_epi32(a.v, b.v)}; }
+static inline SimdInt simdToInt(SimdFloat a) { return {_mm256_cvttps_epi32(a.v)}; }
+static inline SimdFloat simdToFloat(SimdInt a) { return {_mm256_cvtepi32_ps(a.v)}; }
+static inline SimdInt simdShiftRight(SimdInt a, int bits) { return {_mm256_srli_epi32(a.v, bits)}; }
+static inline SimdInt simdAndInt(SimdInt a, int32_t mask) {
+    return {_mm256_and_si256(a.v, _mm256_set1_epi32(mask))};
+}
+static inline SimdInt simdAddInt(SimdInt a, int32_t b) { return {_mm256_add_epi32(a.v, _mm256_set1_epi32(b))}; }
+static inline SimdFloat simdGather(const float* table, SimdInt index) {
+    return {_mm256_i32gather_ps(table, index.v, 4)};
+}
+
+#elif defined(FMG_SIMD_SSE2)
+
+static const int SIMD_WIDTH = 4;
+static const bool SIMD_ACCELERATED = true;
+
+struct SimdFloat { __m128 v; };
+
+static inline SimdFloat simdLoad(const float* p) { return {_mm_load_ps(p)}; }
+static inline SimdFloat simdLoadUnaligned(const float* p) { return {_mm_loadu_ps(p)}; }
+static inline void simdStore(float* p, SimdFloat a) { _mm_store_ps(p, a.v); }
+static inline SimdFloat simdSet(float x) { return {_mm_set1_ps(x)}; }
+
+static inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return {_mm_add_ps(a.v, b.v)}; }
+static inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return {_mm_sub_ps(a.v, b.v)}; }
+static inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return {_mm_mul_ps(a.v, b.v)}; }
+static inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return {_mm_div_ps(a.v, b.v)}; }
+
+// SSE2 has no floor: truncate, then step down where truncation rounded up
+static inline SimdFloat simdFloor(SimdFloat a) {
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+    return {_mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.0f)))};
+}
+static inline SimdFloat simdGreater(SimdFloat a, SimdFloat b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+static inline SimdFloat simdGreaterEqual(SimdFloat a, SimdFloat b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+static inline SimdFloat simdAnd(SimdFloat mask, SimdFloat a) { return {_mm_and_ps(mask.v, a.v)}; }
+static inline SimdFloat simdSelect(SimdFloat mask, SimdFloat a, SimdFloat b) {
+    return {_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))};
+}
+// Rounds with the current MXCSR mode (round-to-nearest by default)
+static inline SimdFloat simdRound(SimdFloat a) { return {_mm_cvtepi32_ps(_mm_cvtps_epi32(a.v))}; }
+
+// 32-bit integer lanes (fixed-point oscillator phases)
+struct SimdInt { __m128i v; };
+
+static inline SimdInt simdLoadInt(const int32_t* p) {
+    return {_mm_load_si128(reinterpret_cast<const __m128i*>(p))};
+}
+static inline void simdStoreInt(int32_t* p, SimdInt a) {
+    _mm_store_si128(reinterpret_cast<__m128i*>(p), a.v);
+}
+static inline SimdInt operator+(SimdInt a, SimdInt b) { return {_mm_add_epi32(a.v, b.v)}; }
+static inline SimdInt simdToInt(SimdFloat a) { return {_mm_cvttps_epi32(a.v)}; }
+static inline SimdFloat simdToFloat(SimdInt a) { return {_mm_cvtepi32_ps(a.v)}; }
+static inline SimdInt simdShiftRight(SimdInt a, int bits) { return {_mm_srli_epi32(a.v, bits)}; }
+static inline SimdInt simdAndInt(SimdInt a, int32_t mask) {
+    return {_mm_and_si128(a.v, _mm_set1_epi32(mask))};
+}
+static inline SimdInt simdAddInt(SimdInt a, int32_t b) { return {_mm_add_epi32(a.v, _mm_set1_epi32(b))}; }
+// No gather before AVX2: spill the indices and load lane by lane
+static inline SimdFloat simdGather(const float* table, SimdInt index) {
+    alignas(16) int32_t idx[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(idx), index.v);
+    return {_mm_set_ps(table[idx[3]], table[idx[2]], table[idx[1]], table[idx[0]])};
+}
+
+#else
+
+#include <cmath>
+
+static const int SIMD_WIDTH = 4;
+static const bool SIMD_ACCELERATED = false;
+
+// Masks are stored as 1.0f (true) / 0.0f (false) in the fallback
+struct SimdFloat { float v[SIMD_WIDTH]; };
+
+#define FMG_SIMD_LANES(expr) \
+    SimdFloat r; \
+    for (int i = 0; i < SIMD_WIDTH; ++i) r.v[i] = (expr); \
+    return r
+
+static inline SimdFloat simdLoad(const float* p) { FMG_SIMD_LANES(p[i]); }
+static inline SimdFloat simdLoadUnaligned(const float* p) { FMG_SIMD_LANES(p[i]); }
+static inline void simdStore(float* p, SimdFloat a) {
+    for (int i = 0; i < SIMD_WIDTH; ++i) p[i] = a.v[i];
+}
+static inline SimdFloat simdSet(float x) { FMG_SIMD_LANES(x); }
+
+static inline SimdFloat operator+(SimdFloat a, SimdFloat b) { FMG_SIMD_LANES(a.v[i] + b.v[i]); }
+static inline SimdFloat operator-(SimdFloat a, SimdFloat b) { FMG_SIMD_LANES(a.v[i] - b.v[i]); }
+static inline SimdFloat operator*(SimdFloat a, SimdFloat b) { FMG_SIMD_LANES(a.v[i] * b.v[i]); }
+static inline SimdFloat operator/(SimdFloat a, SimdFloat b) { FMG_SIMD_LANES(a.v[i] / b.v[i]); }
+
+static inline SimdFloat simdFloor(SimdFloat a) { FMG_SIMD_LANES(std::floor(a.v[i])); }
+static inline SimdFloat simdGreater(SimdFloat a, SimdFloat b) {
+    FMG_SIMD_LANES(a.v[i] > b.v[i] ? 1.0f : 0.0f);
+}
+static inline SimdFloat simdGreaterEqual(SimdFloat a, SimdFloat b) {
+    FMG_SIMD_LANES(a.v[i] >= b.v[i] ? 1.0f : 0.0f);
+}
+static inline SimdFloat simdAnd(SimdFloat mask, SimdFloat a) {
+    FMG_SIMD_LANES(mask.v[i] != 0.0f ? a.v[i] : 0.0f);
+}
+static inline SimdFloat simdSelect(SimdFloat mask, SimdFloat a, SimdFloat b) {
+    FMG_SIMD_LANES(mask.v[i] != 0.0f ? a.v[i] : b.v[i]);
+}
+static inline SimdFloat simdRound(SimdFloat a) { FMG_SIMD_LANES(std::nearbyint(a.v[i])); }
+
+// 32-bit integer lanes (fixed-point oscillator phases). Arithmetic wraps modulo
+// 2^32 like the SSE2/AVX2 versions.
+struct SimdInt { int32_t v[SIMD_WIDTH]; };
+
+#define FMG_SIMD_INT_LANES(expr) \
+    SimdInt r; \
+    for (int i = 0; i < SIMD_WIDTH; ++i) r.v[i] = (expr); \
+    return r
+
+static inline SimdInt simdLoadInt(const int32_t* p) { FMG_SIMD_INT_LANES(p[i]); }
+static inline void simdStoreInt(int32_t* p, SimdInt a) {
+    for (int i = 0; i < SIMD_WIDTH; ++i) p[i] = a.v[i];
+}
+static inline SimdInt operator+(SimdInt a, SimdInt b) {
+    FMG_SIMD_INT_LANES(static_cast<int32_t>(static_cast<uint32_t>(a.v[i]) + static_cast<uint32_t>(b.v[i])));
+}
+// Out-of-range values map to INT32_MIN, as cvttps does
+static inline SimdInt simdToInt(SimdFloat a) {
+    FMG_SIMD_INT_LANES((a.v[i] >= -2147483648.0f && a.v[i] < 2147483648.0f)
+                       ? static_cast<int32_t>(a.v[i]) : INT32_MIN);
+}
+static inline SimdFloat simdToFloat(SimdInt a) { FMG_SIMD_LANES(static_cast<float>(a.v[i])); }
+static inline SimdInt simdShiftRight(SimdInt a, int bits) {
+    FMG_SIMD_INT_LANES(static_cast<int32_t>(static_cast<uint32_t>(a.v[i]) >> bits));
+}
+static inline SimdInt simdAndInt(SimdInt a, int32_t mask) { FMG_SIMD_INT_LANES(a.v[i] & mask); }
+static inline SimdInt simdAddInt(SimdInt a, int32_t b) {
+    FMG_SIMD_INT_LANES(static_cast<int32_t>(static_cast<uint32_t>(a.v[i]) + static_cast<uint32_t>(b)));
+}
+static inline SimdFloat simdGather(const float* table, SimdInt index) { FMG_SIMD_LANES(table[index.v[i]]); }
+
+#undef FMG_SIMD_INT_LANES
+#undef FMG_SIMD_LANES
+
+#endif
+
+static inline SimdFloat operator*(SimdFloat a, float b) { return a * simdSet(b); }
+static inline SimdFloat operator+(SimdFloat a, float b) { return a + simdSet(b); }
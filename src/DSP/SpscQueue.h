@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Bounded lock-free queue for one producer thread and one consumer thread.
+//
+// CAPACITY is a power of two; read and write counters run freely and are masked on
+// access. Each side only writes its own counter, so push and pop are wait-free: a
+// push into a full queue fails instead of waiting for the consumer.
+template<typename T, int CAPACITY>
+class SpscQueue {
+public:
+    static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0,
+                  "capacity must be a power of two");
+
+    // Producer side. Returns false if the queue is full.
+    bool push(const T& item) {
+        uint32_t write = write_.load(std::memory_order_relaxed);
+        if (write - read_.load(std::memory_order_acquire) == CAPACITY) return false;
+        items_[write & MASK] = item;
+        write_.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: the oldest item, or nullptr if the queue is empty
+    const T* peek() const {
+        uint32_t read = read_.load(std::memory_order_relaxed);
+        if (read == write_.load(std::memory_order_acquire)) return nullptr;
+        return &items_[read & MASK];
+    }
+
+    // Consumer side: drop the item returned by peek()
+    void pop() {
+        read_.store(read_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    static constexpr uint32_t MASK = CAPACITY - 1;
+
+    alignas(64) std::atomic<uint32_t> write_{0};
+    alignas(64) std::atomic<uint32_t> read_{0};
+    T items_[CAPACITY];
+};
@@ -1,81 +1,126 @@
 #pragma once
 
 #include "Constants.h"
+#include "Simd.h"
+#include "QuadratureOscillator.h"
+#include "Trace.h"
+#include <algorithm>
 #include <vector>
 #include <cmath>
 
+// Two modulated taps (mid and side, LFOs a quarter cycle apart) on one input ring;
+// one quadrature oscillator drives both, the side LFO being its cosine. The ring is
+// a power of two long, sized in setSampleRate() for the longest tap plus one span,
+// and wrapped with a mask. Each span is written to the ring first; the fractional
+// tap reads then only touch written samples and run SIMD_WIDTH at a time.
 class StereoChorus {
 public:
-    static constexpr int MAX_BUFFER_SIZE = 8192;
-    
-    StereoChorus() : rate_(1.0f), depth_(0.3f), sampleRate_(48000.0f),
-                     writePos_(0), lfoPhaseMid_(0.0f), lfoPhaseSide_(0.25f) {
-        bufferMid_.resize(MAX_BUFFER_SIZE, 0.0f);
-        bufferSide_.resize(MAX_BUFFER_SIZE, 0.0f);
+    static constexpr float BASE_DELAY = 0.02f;    // seconds
+    static constexpr float DEPTH_DELAY = 0.01f;   // seconds at full depth
+    static constexpr int MAX_SPAN = 256;
+
+    StereoChorus() : writePos_(0), mask_(0), rate_(1.0f), depth_(0.3f),
+                     sampleRate_(0.0f) {
+        setSampleRate(48000.0f);
+        lfo_.setPhase(0.0f);
+    }
+
+    void setRate(float rate) {
+        rate_ = clampf(rate, 0.1f, 10.0f);
+        lfo_.setIncrement(rate_ / sampleRate_);
     }
-    
-    void setRate(float rate) { rate_ = clampf(rate, 0.1f, 10.0f); }
     void setDepth(float depth) { depth_ = clampf(depth, 0.0f, 1.0f); }
-    void setSampleRate(float sr) { sampleRate_ = sr; }
-    
-    void process(float input, float& outLeft, float& outRight) {
-        float mid = input;
-        float side = input;
-        
-        float lfoMid = std::sin(lfoPhaseMid_ * 6.28318530718f);
-        lfoPhaseMid_ += rate_ / sampleRate_;
-        if (lfoPhaseMid_ >= 1.0f) lfoPhaseMid_ -= 1.0f;
-        
-        float lfoSide = std::sin(lfoPhaseSide_ * 6.28318530718f);
-        lfoPhaseSide_ += rate_ / sampleRate_;
-        if (lfoPhaseSide_ >= 1.0f) lfoPhaseSide_ -= 1.0f;
-        
-        float delayedMid = processBuffer(bufferMid_, lfoMid);
-        mid = mid + delayedMid * 0.5f;
-        
-        float delayedSide = processBuffer(bufferSide_, lfoSide);
-        side = side + delayedSide * 0.5f;
-        
-        outLeft = (mid + side) * 0.707f;
-        outRight = (mid - side) * 0.707f;
+    float getRate() const { return rate_; }
+    float getDepth() const { return depth_; }
+
+    // Longest time an input stays in the taps, in samples
+    int getTailSamples() const {
+        return static_cast<int>((BASE_DELAY + DEPTH_DELAY) * sampleRate_) + 2;
+    }
+
+    // Resizes and clears the ring; call outside processing
+    void setSampleRate(float sr) {
+        sampleRate_ = sr;
+        lfo_.setIncrement(rate_ / sr);
+        int longest = static_cast<int>((BASE_DELAY + DEPTH_DELAY) * sr) + 2;
+        int size = 1;
+        while (size < longest + MAX_SPAN) size <<= 1;
+        mask_ = size - 1;
+        buffer_.assign(size, 0.0f);
+        writePos_ = 0;
     }
-    
+
+    void processBlock(const float* input, float* outLeft, float* outRight, int numSamples) {
+        FMG_TRACE_SCOPE("StereoChorus::processBlock");
+        alignas(64) float readMid[MAX_SPAN + SIMD_WIDTH];
+        alignas(64) float readSide[MAX_SPAN + SIMD_WIDTH];
+        alignas(64) float delayedMid[MAX_SPAN + SIMD_WIDTH];
+        alignas(64) float delayedSide[MAX_SPAN + SIMD_WIDTH];
+        alignas(64) float lfoMid[MAX_SPAN];
+        alignas(64) float lfoSide[MAX_SPAN];
+
+        float delayBase = BASE_DELAY * sampleRate_;
+        float delayDepth = depth_ * DEPTH_DELAY * sampleRate_;
+
+        for (int pos = 0; pos < numSamples;) {
+            int n = std::min(numSamples - pos, MAX_SPAN);
+            const float* in = input + pos;
+
+            for (int s = 0; s < n; ++s) {
+                buffer_[(writePos_ + s) & mask_] = in[s];
+            }
+
+            // Tap positions, as fractional ring indices (may be negative before masking)
+            lfo_.fill(lfoMid, lfoSide, n);
+            for (int s = 0; s < n; ++s) {
+                float now = static_cast<float>(writePos_ + s);
+                readMid[s] = now - (delayBase + delayDepth * lfoMid[s]);
+                readSide[s] = now - (delayBase + delayDepth * lfoSide[s]);
+            }
+            // Pad to whole vectors; the extra lanes are computed and dropped
+            for (int s = n; s < ((n + SIMD_WIDTH - 1) & ~(SIMD_WIDTH - 1)); ++s) {
+                readMid[s] = readMid[n - 1];
+                readSide[s] = readSide[n - 1];
+            }
+
+            for (int s = 0; s < n; s += SIMD_WIDTH) {
+                simdStore(delayedMid + s, readTap(simdLoad(readMid + s)));
+                simdStore(delayedSide + s, readTap(simdLoad(readSide + s)));
+            }
+
+            for (int s = 0; s < n; ++s) {
+                float mid = in[s] + delayedMid[s] * 0.5f;
+                float side = in[s] + delayedSide[s] * 0.5f;
+                outLeft[pos + s] = (mid + side) * 0.707f;
+                outRight[pos + s] = (mid - side) * 0.707f;
+            }
+
+            writePos_ = (writePos_ + n) & mask_;
+            pos += n;
+        }
+    }
+
     void reset() {
-        std::fill(bufferMid_.begin(), bufferMid_.end(), 0.0f);
-        std::fill(bufferSide_.begin(), bufferSide_.end(), 0.0f);
+        std::fill(buffer_.begin(), buffer_.end(), 0.0f);
         writePos_ = 0;
-        lfoPhaseMid_ = 0.0f;
-        lfoPhaseSide_ = 0.25f;
+        lfo_.setPhase(0.0f);
     }
-    
+
 private:
-    float processBuffer(std::vector<float>& buffer, float lfoValue) {
-        float delayTime = 0.02f + depth_ * 0.01f * lfoValue;
-        float delaySamplesF = delayTime * sampleRate_;
-        int delaySamples = static_cast<int>(delaySamplesF);
-        float frac = delaySamplesF - delaySamples;
-        
-        if (delaySamples >= MAX_BUFFER_SIZE - 1) delaySamples = MAX_BUFFER_SIZE - 2;
-        if (delaySamples < 1) delaySamples = 1;
-        
-        int readPos0 = writePos_ - delaySamples;
-        if (readPos0 < 0) readPos0 += MAX_BUFFER_SIZE;
-        int readPos1 = readPos0 - 1;
-        if (readPos1 < 0) readPos1 += MAX_BUFFER_SIZE;
-        
-        float delayed = buffer[readPos0] * (1.0f - frac) + buffer[readPos1] * frac;
-        
-        buffer[writePos_] = delayed;
-        writePos_ = (writePos_ + 1) % MAX_BUFFER_SIZE;
-        
-        return delayed;
+    // Linear interpolation at fractional ring positions
+    SimdFloat readTap(SimdFloat position) const {
+        SimdFloat whole = simdFloor(position);
+        SimdFloat frac = position - whole;
+        SimdInt index = simdToInt(whole);
+        SimdFloat a = simdGather(buffer_.data(), simdAndInt(index, mask_));
+        SimdFloat b = simdGather(buffer_.data(), simdAndInt(simdAddInt(index, 1), mask_));
+        return a + (b - a) * frac;
     }
-    
-    std::vector<float> bufferMid_;
-    std::vector<float> bufferSide_;
+
+    std::vector<float> buffer_;
     int writePos_;
-    float lfoPhaseMid_;
-    float lfoPhaseSide_;
+    int mask_;
+    QuadratureOscillator lfo_;
     float rate_;
     float depth_;
     float sampleRate_;
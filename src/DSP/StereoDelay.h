@@ -1,59 +1,109 @@
 #pragma once
 
 #include "Constants.h"
+#include "DenormalGuard.h"
+#include "Trace.h"
+#include <algorithm>
 #include <vector>
 #include <cmath>
 
+// Mid/side feedback delay. The rings are a power of two long, sized in
+// setSampleRate() for MAX_TIME, and wrapped with a mask. A block is processed in
+// spans no longer than the delay, so every read in a span is of samples written
+// before it: the delayed signal is copied out as one contiguous run (two at the
+// wrap), mixed, and the span written back the same way.
 class StereoDelay {
 public:
-    static constexpr int MAX_BUFFER_SIZE = 192000;
-    
+    static constexpr float MAX_TIME = 2.0f;   // seconds
+    static constexpr int MAX_SPAN = 256;
+
     StereoDelay() : time_(0.25f), feedback_(0.3f), crossFeedback_(0.1f),
-                    sampleRate_(48000.0f), writePos_(0) {
-        bufferMid_.resize(MAX_BUFFER_SIZE, 0.0f);
-        bufferSide_.resize(MAX_BUFFER_SIZE, 0.0f);
+                    sampleRate_(0.0f), writePos_(0), mask_(0) {
+        setSampleRate(48000.0f);
     }
-    
-    void setTime(float time) { time_ = clampf(time, 0.001f, 2.0f); }
+
+    void setTime(float time) { time_ = clampf(time, 0.001f, MAX_TIME); }
     void setFeedback(float fb) { feedback_ = clampf(fb, 0.0f, 0.9f); }
     void setCrossFeedback(float cross) { crossFeedback_ = clampf(cross, 0.0f, 0.3f); }
-    void setSampleRate(float sr) { sampleRate_ = sr; }
-    
-    void process(float input, float& outLeft, float& outRight) {
-        int delaySamples = static_cast<int>(time_ * sampleRate_);
-        if (delaySamples >= MAX_BUFFER_SIZE) delaySamples = MAX_BUFFER_SIZE - 1;
-        if (delaySamples < 1) delaySamples = 1;
-        
-        float mid = input;
-        float side = input;
-        
-        int readPosMid = writePos_ - delaySamples;
-        if (readPosMid < 0) readPosMid += MAX_BUFFER_SIZE;
-        
-        float delayedMid = bufferMid_[readPosMid];
-        float delayedSide = bufferSide_[readPosMid];
-        
-        bufferMid_[writePos_] = mid + delayedMid * feedback_ + delayedSide * crossFeedback_;
-        bufferSide_[writePos_] = side + delayedSide * feedback_ + delayedMid * crossFeedback_;
-        
-        writePos_ = (writePos_ + 1) % MAX_BUFFER_SIZE;
-        
-        outLeft = (mid + delayedMid + side + delayedSide) * 0.5f;
-        outRight = (mid + delayedMid - side - delayedSide) * 0.5f;
+    float getTime() const { return time_; }
+    float getFeedback() const { return feedback_; }
+
+    // Delay before an input is first heard, in samples
+    int getTailSamples() const { return delaySamples(); }
+
+    // Resizes and clears the rings; call outside processing
+    void setSampleRate(float sr) {
+        sampleRate_ = sr;
+        int size = 1;
+        while (size <= static_cast<int>(MAX_TIME * sr)) size <<= 1;
+        mask_ = size - 1;
+        bufferMid_.assign(size, 0.0f);
+        bufferSide_.assign(size, 0.0f);
+        writePos_ = 0;
+    }
+
+    // Output in float or double; the delay lines stay float
+    template<typename T>
+    void processBlock(const float* input, T* outLeft, T* outRight, int numSamples) {
+        FMG_TRACE_SCOPE("StereoDelay::processBlock");
+        int delay = delaySamples();
+        float delayedMid[MAX_SPAN], delayedSide[MAX_SPAN];
+        float writeMid[MAX_SPAN], writeSide[MAX_SPAN];
+
+        for (int pos = 0; pos < numSamples;) {
+            int n = std::min(std::min(numSamples - pos, delay), MAX_SPAN);
+            int readPos = (writePos_ - delay) & mask_;
+            readRing(bufferMid_, readPos, delayedMid, n);
+            readRing(bufferSide_, readPos, delayedSide, n);
+
+            const float* in = input + pos;
+            for (int s = 0; s < n; ++s) {
+                float mid = in[s];
+                float side = in[s];
+                writeMid[s] = flushDenormal(mid + delayedMid[s] * feedback_ +
+                                            delayedSide[s] * crossFeedback_);
+                writeSide[s] = flushDenormal(side + delayedSide[s] * feedback_ +
+                                             delayedMid[s] * crossFeedback_);
+                outLeft[pos + s] = static_cast<T>((mid + delayedMid[s] + side + delayedSide[s]) * 0.5f);
+                outRight[pos + s] = static_cast<T>((mid + delayedMid[s] - side - delayedSide[s]) * 0.5f);
+            }
+
+            writeRing(bufferMid_, writePos_, writeMid, n);
+            writeRing(bufferSide_, writePos_, writeSide, n);
+            writePos_ = (writePos_ + n) & mask_;
+            pos += n;
+        }
     }
-    
+
     void reset() {
         std::fill(bufferMid_.begin(), bufferMid_.end(), 0.0f);
         std::fill(bufferSide_.begin(), bufferSide_.end(), 0.0f);
         writePos_ = 0;
     }
-    
+
 private:
+    int delaySamples() const {
+        return std::max(1, std::min(static_cast<int>(time_ * sampleRate_), mask_));
+    }
+
+    void readRing(const std::vector<float>& ring, int pos, float* out, int n) const {
+        int first = std::min(n, mask_ + 1 - pos);
+        std::copy(ring.begin() + pos, ring.begin() + pos + first, out);
+        std::copy(ring.begin(), ring.begin() + (n - first), out + first);
+    }
+
+    void writeRing(std::vector<float>& ring, int pos, const float* in, int n) {
+        int first = std::min(n, mask_ + 1 - pos);
+        std::copy(in, in + first, ring.begin() + pos);
+        std::copy(in + first, in + n, ring.begin());
+    }
+
     std::vector<float> bufferMid_;
     std::vector<float> bufferSide_;
-    int writePos_;
     float time_;
     float feedback_;
     float crossFeedback_;
     float sampleRate_;
+    int writePos_;
+    int mask_;
 };
@@ -0,0 +1,168 @@
+#pragma once
+
+// Scoped timers and counters for finding where block time goes, exported as
+// Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+//
+//   FMG_TRACE_SCOPE("name")          time the enclosing scope
+//   FMG_TRACE_COUNTER("name", value) record a value over time
+//   FMG_TRACE_THREAD("name")         label the calling thread in the trace
+//
+// Compiled in only when FMG_TRACE is defined to 1 (CMake option
+// FREQMODGRID_TRACE); otherwise the macros expand to nothing and
+// Trace::writeChromeJson() reports that tracing is unavailable.
+//
+// Each thread records into its own ring of the last RING_SIZE events, so recording
+// takes no lock and never waits; the oldest events are overwritten. A thread's ring
+// is allocated on its first event (or FMG_TRACE_THREAD), so call that before
+// real-time work starts. Names must be string literals or otherwise outlive the
+// trace. writeChromeJson() can run while other threads record: events overwritten
+// during the copy are dropped.
+
+#if defined(FMG_TRACE) && FMG_TRACE
+
+#include "RealtimeCheck.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace Trace {
+
+constexpr bool ENABLED = true;
+constexpr uint32_t RING_SIZE = 1 << 16;   // events per thread
+
+struct Event {
+    const char* name;
+    int64_t start;      // nanoseconds since the trace epoch
+    int64_t duration;   // nanoseconds; < 0 marks a counter
+    double value;
+};
+
+struct ThreadRing {
+    Event events[RING_SIZE];
+    std::atomic<uint64_t> written {0};
+    std::atomic<const char*> name {nullptr};
+    int id = 0;
+    ThreadRing* next = nullptr;
+};
+
+// Rings of every thread that has recorded, newest first. Rings live until exit.
+inline std::atomic<ThreadRing*> rings {nullptr};
+inline std::atomic<int> nextThreadId {1};
+inline const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+inline int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - epoch).count();
+}
+
+inline ThreadRing& threadRing() {
+    thread_local ThreadRing* ring = [] {
+        FMG_REALTIME_ALLOW();   // once per thread, see above
+        ThreadRing* r = new ThreadRing();
+        r->id = nextThreadId.fetch_add(1, std::memory_order_relaxed);
+        r->next = rings.load(std::memory_order_relaxed);
+        while (!rings.compare_exchange_weak(r->next, r, std::memory_order_release,
+                                            std::memory_order_relaxed)) {}
+        return r;
+    }();
+    return *ring;
+}
+
+inline void record(const char* name, int64_t start, int64_t duration, double value) {
+    ThreadRing& ring = threadRing();
+    uint64_t index = ring.written.load(std::memory_order_relaxed);
+    ring.events[index & (RING_SIZE - 1)] = { name, start, duration, value };
+    ring.written.store(index + 1, std::memory_order_release);
+}
+
+inline void setThreadName(const char* name) {
+    threadRing().name.store(name, std::memory_order_relaxed);
+}
+
+inline void counter(const char* name, double value) {
+    record(name, now(), -1, value);
+}
+
+class Scope {
+public:
+    explicit Scope(const char* name) : name_(name), start_(now()) {}
+    ~Scope() { record(name_, start_, now() - start_, 0.0); }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char* name_;
+    int64_t start_;
+};
+
+// Write every thread's recorded events as Chrome trace JSON. Returns false if the
+// file cannot be written.
+inline bool writeChromeJson(const char* path) {
+    std::FILE* file = std::fopen(path, "w");
+    if (!file) return false;
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    auto separator = [&] {
+        if (!first) std::fprintf(file, ",\n");
+        first = false;
+    };
+
+    std::vector<Event> copy;
+    for (ThreadRing* ring = rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+        const char* threadName = ring->name.load(std::memory_order_relaxed);
+        if (threadName) {
+            separator();
+            std::fprintf(file, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,"
+                               "\"args\":{\"name\":\"%s\"}}", ring->id, threadName);
+        }
+
+        // Copy the newest RING_SIZE events, then keep those the writer cannot have
+        // overwritten meanwhile
+        uint64_t end = ring->written.load(std::memory_order_acquire);
+        uint64_t begin = (end > RING_SIZE) ? end - RING_SIZE : 0;
+        copy.clear();
+        for (uint64_t i = begin; i < end; ++i) copy.push_back(ring->events[i & (RING_SIZE - 1)]);
+        uint64_t after = ring->written.load(std::memory_order_acquire);
+        uint64_t valid = (after > RING_SIZE) ? after - RING_SIZE : 0;
+
+        for (uint64_t i = std::max(begin, valid); i < end; ++i) {
+            const Event& e = copy[i - begin];
+            separator();
+            if (e.duration < 0) {
+                std::fprintf(file, "{\"ph\":\"C\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+                                   "\"args\":{\"value\":%g}}", e.name, ring->id, e.start * 1e-3, e.value);
+            } else {
+                std::fprintf(file, "{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+                                   "\"dur\":%.3f}", e.name, ring->id, e.start * 1e-3, e.duration * 1e-3);
+            }
+        }
+    }
+    std::fprintf(file, "\n]}\n");
+    return std::fclose(file) == 0;
+}
+
+}
+
+#define FMG_TRACE_CONCAT2(a, b) a##b
+#define FMG_TRACE_CONCAT(a, b) FMG_TRACE_CONCAT2(a, b)
+#define FMG_TRACE_SCOPE(name) ::Trace::Scope FMG_TRACE_CONCAT(traceScope_, __LINE__)(name)
+#define FMG_TRACE_COUNTER(name, value) ::Trace::counter(name, static_cast<double>(value))
+#define FMG_TRACE_THREAD(name) ::Trace::setThreadName(name)
+
+#else
+
+namespace Trace {
+constexpr bool ENABLED = false;
+inline bool writeChromeJson(const char*) { return false; }
+}
+
+#define FMG_TRACE_SCOPE(name) ((void)0)
+#define FMG_TRACE_COUNTER(name, value) ((void)0)
+#define FMG_TRACE_THREAD(name) ((void)0)
+
+#endif
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <cstdint>
+
+// Voice bookkeeping for FMEngine: which voices are free, which note each one plays,
+// and which one to take when a note arrives with every voice busy.
+//
+// Voices are indices into the engine's voice array. Free voices sit on a stack;
+// allocated ones are linked into three intrusive lists: all voices in note-on order,
+// held or released voices in the order they entered that state, and the voices of
+// each MIDI note. Every operation touches a fixed number of list nodes, so its cost
+// does not grow with polyphony.
+//
+// Stealing is chosen per engine:
+//   STEAL_OLDEST    the voice that started first, whatever its state
+//   STEAL_QUIETEST  the quietest of the STEAL_CANDIDATES longest-released voices, or,
+//                   if nothing is released, of the STEAL_CANDIDATES oldest held ones
+class VoiceAllocator {
+public:
+    static constexpr int MAX_VOICES = 256;
+    static constexpr int NUM_NOTES = 128;
+    static constexpr int STEAL_CANDIDATES = 4;
+
+    enum StealPolicy { STEAL_OLDEST, STEAL_QUIETEST };
+
+    VoiceAllocator() { reset(MAX_VOICES); }
+
+    // Free every voice and use voices [0, numVoices)
+    void reset(int numVoices) {
+        numVoices_ = (numVoices < 1) ? 1 : (numVoices > MAX_VOICES) ? MAX_VOICES : numVoices;
+        numFree_ = 0;
+        // Stack top is voice 0, so voices are handed out in index order
+        for (int v = numVoices_ - 1; v >= 0; --v) {
+            free_[numFree_++] = v;
+        }
+        for (int v = 0; v < MAX_VOICES; ++v) {
+            state_[v] = FREE;
+            note_[v] = -1;
+        }
+        for (List& list : noteLists_) list = List();
+        order_ = held_ = released_ = List();
+        numActive_ = 0;
+    }
+
+    // Use voices [0, numVoices), keeping the ones already playing below the new
+    // count. f(voice) is called for each playing voice that is cut off.
+    template<typename F>
+    void resize(int numVoices, F f) {
+        numVoices = (numVoices < 1) ? 1 : (numVoices > MAX_VOICES) ? MAX_VOICES : numVoices;
+        for (int v = order_.head; v >= 0;) {
+            int next = orderLinks_.next[v];
+            if (v >= numVoices) {
+                f(v);
+                unlinkVoice(v);
+            }
+            v = next;
+        }
+        numVoices_ = numVoices;
+        numFree_ = 0;
+        for (int v = numVoices_ - 1; v >= 0; --v) {
+            if (state_[v] == FREE) free_[numFree_++] = v;
+        }
+    }
+
+    void setStealPolicy(StealPolicy policy) { policy_ = policy; }
+    StealPolicy getStealPolicy() const { return policy_; }
+
+    // Voice to play note: a free one if any, otherwise one taken by the steal policy.
+    // level(voice) gives a voice's current output level, used by STEAL_QUIETEST.
+    template<typename Level>
+    int noteOn(int note, Level level) {
+        int voice;
+        if (numFree_ > 0) {
+            voice = free_[--numFree_];
+        } else {
+            voice = pickVictim(level);
+            unlinkVoice(voice);
+            ++numSteals_;
+        }
+        linkVoice(voice, note & (NUM_NOTES - 1), HELD);
+        return voice;
+    }
+
+    // Move the held voices of note to released, calling f(voice) for each
+    template<typename F>
+    void noteOff(int note, F f) {
+        for (int v = noteLists_[note & (NUM_NOTES - 1)].head; v >= 0;) {
+            int next = noteLinks_.next[v];
+            if (state_[v] == HELD) {
+                unlink(stateLinks_, held_, v);
+                pushBack(stateLinks_, released_, v);
+                state_[v] = RELEASED;
+                f(v);
+            }
+            v = next;
+        }
+    }
+
+    // Return a voice that has finished playing
+    void release(int voice) {
+        if (state_[voice] == FREE) return;
+        unlinkVoice(voice);
+        free_[numFree_++] = voice;
+    }
+
+    // f(voice) for each voice playing note
+    template<typename F>
+    void forEachVoice(int note, F f) const {
+        for (int v = noteLists_[note & (NUM_NOTES - 1)].head; v >= 0; v = noteLinks_.next[v]) {
+            f(v);
+        }
+    }
+
+    // f(voice) for each allocated voice, in note-on order
+    template<typename F>
+    void forEachActive(F f) const {
+        for (int v = order_.head; v >= 0; v = orderLinks_.next[v]) {
+            f(v);
+        }
+    }
+
+    int getNumActive() const { return numActive_; }
+    int getNumVoices() const { return numVoices_; }
+    // Voices taken by noteOn() from a playing note since construction; wraps
+    uint32_t getNumSteals() const { return numSteals_; }
+
+private:
+    enum State { FREE, HELD, RELEASED };
+
+    struct List {
+        int head = -1;
+        int tail = -1;
+    };
+    struct Links {
+        int prev[MAX_VOICES];
+        int next[MAX_VOICES];
+    };
+
+    static void pushBack(Links& links, List& list, int v) {
+        links.prev[v] = list.tail;
+        links.next[v] = -1;
+        if (list.tail >= 0) links.next[list.tail] = v;
+        else list.head = v;
+        list.tail = v;
+    }
+
+    static void unlink(Links& links, List& list, int v) {
+        int prev = links.prev[v];
+        int next = links.next[v];
+        if (prev >= 0) links.next[prev] = next;
+        else list.head = next;
+        if (next >= 0) links.prev[next] = prev;
+        else list.tail = prev;
+    }
+
+    void linkVoice(int v, int note, State state) {
+        state_[v] = state;
+        note_[v] = note;
+        pushBack(orderLinks_, order_, v);
+        pushBack(stateLinks_, (state == HELD) ? held_ : released_, v);
+        pushBack(noteLinks_, noteLists_[note], v);
+        ++numActive_;
+    }
+
+    void unlinkVoice(int v) {
+        unlink(orderLinks_, order_, v);
+        unlink(stateLinks_, (state_[v] == HELD) ? held_ : released_, v);
+        unlink(noteLinks_, noteLists_[note_[v]], v);
+        state_[v] = FREE;
+        note_[v] = -1;
+        --numActive_;
+    }
+
+    template<typename Level>
+    int pickVictim(Level level) const {
+        if (policy_ == STEAL_OLDEST) return order_.head;
+
+        const List& pool = (released_.head >= 0) ? released_ : held_;
+        int victim = pool.head;
+        float victimLevel = level(victim);
+        int v = stateLinks_.next[victim];
+        for (int i = 1; i < STEAL_CANDIDATES && v >= 0; ++i, v = stateLinks_.next[v]) {
+            float l = level(v);
+            if (l < victimLevel) {
+                victim = v;
+                victimLevel = l;
+            }
+        }
+        return victim;
+    }
+
+    int numVoices_ = 0;
+    StealPolicy policy_ = STEAL_QUIETEST;
+
+    int free_[MAX_VOICES];
+    int numFree_ = 0;
+    int numActive_ = 0;
+    uint32_t numSteals_ = 0;
+
+    State state_[MAX_VOICES];
+    int note_[MAX_VOICES];
+
+    Links orderLinks_, stateLinks_, noteLinks_;
+    List order_, held_, released_;
+    List noteLists_[NUM_NOTES];
+};
@@ -0,0 +1,206 @@
+#pragma once
+
+#include "Simd.h"
+#include "SineTable.h"
+#include "Algorithms.h"
+#include "Operator.h"
+#include "Filter.h"
+
+// Structure-of-arrays bank of up to LANES voices for the SIMD render path.
+//
+// Operator and filter state, including any control-rate ramps in progress, is
+// gathered from the scalar Operator/Filter objects with loadLane() and written back
+// with storeLane(), so those classes remain the reference implementation. The engine
+// does the control-rate work on the scalar objects between render() calls and fills
+// the per-sample envelope gain for each lane; render() then advances every lane at
+// once.
+class VoiceBank {
+public:
+    static constexpr int LANES = SIMD_WIDTH;
+    static constexpr int NUM_OPERATORS = 6;
+    static constexpr int MAX_CHUNK = 32;
+
+    VoiceBank() { clear(); }
+
+    // Zero all state and gains; lanes that are never loaded render silence
+    void clear() {
+        for (int l = 0; l < LANES; ++l) {
+            stopLane(l);
+            for (int op = 0; op < NUM_OPERATORS; ++op) {
+                phase_[op][l] = 0;
+                increment_[op][l] = 0;
+                level_[op][l] = 0.0f;
+                feedback_[op][l] = 0.0f;
+                feedbackSample_[op][l] = 0.0f;
+            }
+            s1_[l] = 0.0f;
+            s2_[l] = 0.0f;
+        }
+        for (int s = 0; s < MAX_CHUNK; ++s) {
+            for (int l = 0; l < LANES; ++l) {
+                silence(s, l);
+            }
+        }
+    }
+
+    // Gather operator and filter state for one lane
+    void loadLane(int lane, const Operator* operators, const Filter& filter) {
+        for (int op = 0; op < NUM_OPERATORS; ++op) {
+            phase_[op][lane] = static_cast<int32_t>(operators[op].phase_);
+            increment_[op][lane] = static_cast<int32_t>(operators[op].increment_);
+            incrementStep_[op][lane] = operators[op].incrementStep_;
+            level_[op][lane] = operators[op].level_;
+            feedback_[op][lane] = operators[op].feedback_;
+            feedbackSample_[op][lane] = operators[op].feedbackSample_;
+        }
+        for (int c = 0; c < Filter::NUM_COEFS; ++c) {
+            coef_[c][lane] = filter.coef_[c];
+            delta_[c][lane] = filter.delta_[c];
+        }
+        s1_[lane] = filter.s1_;
+        s2_[lane] = filter.s2_;
+    }
+
+    // Scatter the running state of one lane back into the scalar objects
+    void storeLane(int lane, Operator* operators, Filter& filter) const {
+        for (int op = 0; op < NUM_OPERATORS; ++op) {
+            operators[op].phase_ = static_cast<uint32_t>(phase_[op][lane]);
+            operators[op].increment_ = static_cast<uint32_t>(increment_[op][lane]);
+            operators[op].feedbackSample_ = feedbackSample_[op][lane];
+            operators[op].output_ = feedbackSample_[op][lane];
+        }
+        for (int c = 0; c < Filter::NUM_COEFS; ++c) {
+            filter.coef_[c] = coef_[c][lane];
+        }
+        filter.s1_ = s1_[lane];
+        filter.s2_ = s2_[lane];
+    }
+
+    // Freeze a lane whose voice has ended: no ramps, and a filter with all-zero
+    // coefficients, which for either topology holds or drains its state rather than
+    // drifting while the lane renders gated silence
+    void stopLane(int lane) {
+        for (int op = 0; op < NUM_OPERATORS; ++op) {
+            incrementStep_[op][lane] = 0;
+        }
+        for (int c = 0; c < Filter::NUM_COEFS; ++c) {
+            coef_[c][lane] = 0.0f;
+            delta_[c][lane] = 0.0f;
+        }
+    }
+
+    // Per-sample output gain (envelope, velocity, volume) for one lane
+    void setGain(int sample, int lane, float amp) {
+        amp_[sample][lane] = amp;
+        gate_[sample][lane] = 1.0f;
+    }
+
+    // Mark a lane as finished for this sample (its output is gated to zero)
+    void silence(int sample, int lane) {
+        amp_[sample][lane] = 0.0f;
+        gate_[sample][lane] = 0.0f;
+    }
+
+    // Per-algorithm render kernel: advances all lanes by numSamples (<= MAX_CHUNK)
+    // through the operator stack, carrier mix, envelope gain and filter topology T
+    typedef void (VoiceBank::*Kernel)(int numSamples);
+
+    template<int A, Filter::Topology T>
+    void render(int numSamples) {
+        SimdFloat c[Filter::NUM_COEFS], dc[Filter::NUM_COEFS];
+        for (int i = 0; i < Filter::NUM_COEFS; ++i) {
+            c[i] = simdLoad(coef_[i]);
+            dc[i] = simdLoad(delta_[i]);
+        }
+        SimdFloat s1 = simdLoad(s1_);
+        SimdFloat s2 = simdLoad(s2_);
+
+        for (int s = 0; s < numSamples; ++s) {
+            SimdFloat voiceOut = evaluateAlgorithm<A>([&](auto op, SimdFloat modInput) {
+                SimdInt increment = simdLoadInt(increment_[op]) + simdLoadInt(incrementStep_[op]);
+                simdStoreInt(increment_[op], increment);
+                SimdInt phase = simdLoadInt(phase_[op]) + increment;
+                simdStoreInt(phase_[op], phase);
+
+                SimdFloat fb = simdLoad(feedback_[op]) * simdLoad(feedbackSample_[op]) * 5.0f;
+                SimdInt totalPhase = phase + SineTable::radiansToPhase(fb + modInput);
+                SimdFloat out = simdLoad(level_[op]) * SineTable::lookup(totalPhase);
+                simdStore(feedbackSample_[op], out);
+                return out;
+            }, simdSet(0.0f));
+
+            voiceOut = voiceOut * simdLoad(amp_[s]);
+
+            for (int i = 0; i < Filter::NUM_COEFS; ++i) c[i] = c[i] + dc[i];
+
+            // Same structures as Filter::process
+            SimdFloat y;
+            if constexpr (T == Filter::BIQUAD) {
+                y = c[0] * voiceOut + s1;
+                s1 = c[1] * voiceOut - c[3] * y + s2;
+                s2 = c[2] * voiceOut - c[4] * y;
+            } else {
+                SimdFloat v3 = voiceOut - s2;
+                SimdFloat v1 = c[0] * s1 + c[1] * v3;
+                SimdFloat v2 = s2 + c[1] * s1 + c[2] * v3;
+                s1 = v1 + v1 - s1;
+                s2 = v2 + v2 - s2;
+                y = v2 + c[3] * (voiceOut - (v2 + v2)) + c[4] * v1;
+            }
+
+            simdStore(output_[s], y * simdLoad(gate_[s]));
+        }
+
+        for (int i = 0; i < Filter::NUM_COEFS; ++i) simdStore(coef_[i], c[i]);
+        simdStore(s1_, s1);
+        simdStore(s2_, s2);
+    }
+
+    static Kernel kernelFor(int algorithm, Filter::Topology topology) {
+        static const Kernel biquad[8] = {
+            &VoiceBank::render<0, Filter::BIQUAD>, &VoiceBank::render<1, Filter::BIQUAD>,
+            &VoiceBank::render<2, Filter::BIQUAD>, &VoiceBank::render<3, Filter::BIQUAD>,
+            &VoiceBank::render<4, Filter::BIQUAD>, &VoiceBank::render<5, Filter::BIQUAD>,
+            &VoiceBank::render<6, Filter::BIQUAD>, &VoiceBank::render<7, Filter::BIQUAD>
+        };
+        static const Kernel svf[8] = {
+            &VoiceBank::render<0, Filter::SVF>, &VoiceBank::render<1, Filter::SVF>,
+            &VoiceBank::render<2, Filter::SVF>, &VoiceBank::render<3, Filter::SVF>,
+            &VoiceBank::render<4, Filter::SVF>, &VoiceBank::render<5, Filter::SVF>,
+            &VoiceBank::render<6, Filter::SVF>, &VoiceBank::render<7, Filter::SVF>
+        };
+        return (topology == Filter::BIQUAD) ? biquad[algorithm] : svf[algorithm];
+    }
+
+    // Sum the lanes of the last render() into dst
+    void mixTo(float* dst, int numSamples) const {
+        for (int s = 0; s < numSamples; ++s) {
+            float sum = 0.0f;
+            for (int l = 0; l < LANES; ++l) {
+                sum += output_[s][l];
+            }
+            dst[s] += sum;
+        }
+    }
+
+private:
+    // Operator state, [operator][lane]; phases and increments are fixed-point as in
+    // Operator
+    alignas(32) int32_t phase_[NUM_OPERATORS][LANES];
+    alignas(32) int32_t increment_[NUM_OPERATORS][LANES];
+    alignas(32) int32_t incrementStep_[NUM_OPERATORS][LANES];
+    alignas(32) float level_[NUM_OPERATORS][LANES];
+    alignas(32) float feedback_[NUM_OPERATORS][LANES];
+    alignas(32) float feedbackSample_[NUM_OPERATORS][LANES];
+
+    // Filter coefficients and their ramp increments, [coefficient][lane], and state
+    alignas(32) float coef_[Filter::NUM_COEFS][LANES];
+    alignas(32) float delta_[Filter::NUM_COEFS][LANES];
+    alignas(32) float s1_[LANES];
+    alignas(32) float s2_[LANES];
+
+    // Per-sample gain and output, [sample][lane]
+    alignas(32) float amp_[MAX_CHUNK][LANES];
+    alignas(32) float gate_[MAX_CHUNK][LANES];
+    alignas(32) float output_[MAX_CHUNK][LANES];
+};
@@ -1,6 +1,8 @@
 #include "FreqmodGrid.h"
 #include "IPlug_include_in_plug_src.h"
 #include "IControls.h"
+#include "../DSP/Trace.h"
+#include <string>
 
 FreqmodGrid::FreqmodGrid(const InstanceInfo& info)
 : Plugin(info, MakeConfig(kNumParams, kNumPresets))
@@ -40,6 +42,8 @@ FreqmodGrid::FreqmodGrid(const InstanceInfo& info)
     IParam::kFlagsNone, "", "LP", "HP");
   GetParam(kParamFilterCutoff)->InitFrequency("Filter Cutoff", 12000., 20., 20000.);
   GetParam(kParamFilterRes)->InitDouble("Filter Resonance", 0., 0., 100., 1., "%");
+  GetParam(kParamFilterTopology)->InitEnum("Filter Mode", 0, 2, "",
+    IParam::kFlagsNone, "", "Biquad", "SVF");
 
   // Envelope
   GetParam(kParamAttack)->InitDouble("Attack", 10., 1., 5000., 0.1, "ms",
@@ -65,7 +69,14 @@ FreqmodGrid::FreqmodGrid(const InstanceInfo& info)
 
   // Master
   GetParam(kParamMasterVolume)->InitDouble("Master Volume", 70., 0., 100., 1., "%");
-  GetParam(kParamOversample)->InitEnum("Oversample", 0, 3, "", IParam::kFlagsNone, "", "Off,2x,4x");
+  GetParam(kParamOversample)->InitEnum("Oversample", 0, 4, "", IParam::kFlagsNone, "", "Off,2x,4x,Auto");
+  GetParam(kParamOversampleFilter)->InitEnum("Oversample Filter", 0, 2, "",
+    IParam::kFlagsNone, "", "Linear Phase", "Low Latency");
+  GetParam(kParamPolyphony)->InitInt("Polyphony", FMEngine::DEFAULT_POLYPHONY, 1,
+    FMEngine::MAX_VOICES, "voices");
+  // Off by default: each instance would start its own real-time workers
+  GetParam(kParamRenderThreads)->InitInt("Render Threads", 0, 0,
+    RenderThreadPool::MAX_THREADS - 1, "threads", IParam::kFlagCannotAutomate);
   
   // Initialize preset manager
   mPresetManager.loadFactoryPresets("resources/presets/factory_presets.json");
@@ -137,6 +148,7 @@ FreqmodGrid::FreqmodGrid(const InstanceInfo& info)
       IText(10, IColor(255, 0, 212, 255)));
     pGraphics->AttachControl(filterLabel);
     pGraphics->AttachControl(new IVSwitchControl(IRECT(10, y + 18, 60, y + 38), kParamFilterType, "", style));
+    pGraphics->AttachControl(new IVSwitchControl(IRECT(10, y + 40, 60, y + 58), kParamFilterTopology, "", style));
     pGraphics->AttachControl(new IVKnobControl(IRECT(70, y + 18, 120, y + 58), kParamFilterCutoff, "Cutoff", style));
     pGraphics->AttachControl(new IVKnobControl(IRECT(125, y + 18, 175, y + 58), kParamFilterRes, "Res", style));
     
@@ -180,19 +192,45 @@ FreqmodGrid::FreqmodGrid(const InstanceInfo& info)
     pGraphics->AttachControl(masterLabel);
     pGraphics->AttachControl(new IVKnobControl(IRECT(250, y + 18, 320, y + 65), kParamMasterVolume, "Vol", style));
     
-    // Oversampling toggle buttons (Off/2x/4x)
+    // Oversampling toggle buttons (Off/2x/4x/Auto)
     auto osLabel = new ITextControl(IRECT(340, y, 400, y + 15), "OS", 
       IText(10, IColor(255, 0, 212, 255)));
     pGraphics->AttachControl(osLabel);
-    for (int i = 0; i < 3; i++) {
-      int x = 340 + i * 35;
-      auto btn = new IVButtonControl(IRECT(x, y + 18, x + 32, y + 42),
-        SplashClickActionFunc, (i == 0) ? "Off" : (i == 1) ? "2x" : "4x", style);
+    const char* osLabels[] = {"Off", "2x", "4x", "Auto"};
+    for (int i = 0; i < 4; i++) {
+      int x = 340 + i * 27;
+      auto btn = new IVButtonControl(IRECT(x, y + 18, x + 25, y + 42),
+        SplashClickActionFunc, osLabels[i], style);
       btn->SetParamIdx(kParamOversample);
       btn->SetValue(i);
       pGraphics->AttachControl(btn);
     }
     
+    pGraphics->AttachControl(new IVSwitchControl(IRECT(340, y + 52, 445, y + 70), kParamOversampleFilter, "", style));
+    pGraphics->AttachControl(new IVKnobControl(IRECT(460, y + 18, 520, y + 65), kParamPolyphony, "Voices", style));
+
+    // DSP load readout, filled in by OnIdle while the editor is open
+    auto loadLabel = new ITextControl(IRECT(530, y, 598, y + 15), "DSP",
+      IText(10, IColor(255, 0, 212, 255)));
+    pGraphics->AttachControl(loadLabel);
+    const IText meterText(10, EAlign::Near, IColor(255, 200, 200, 210));
+    const int meterTags[] = {kCtrlTagLoad, kCtrlTagVoices, kCtrlTagSteals, kCtrlTagEngine};
+    for (int i = 0; i < 4; i++) {
+      int top = y + 18 + i * 13;
+      pGraphics->AttachControl(new ITextControl(IRECT(530, top, 598, top + 13), "-", meterText), meterTags[i]);
+    }
+
+#if FMG_TRACE
+    // Tracing builds: write the recorded trace to the home directory
+    pGraphics->AttachControl(new IVButtonControl(IRECT(520, 5, 590, 25),
+      [](IControl* pCaller) {
+        SplashClickActionFunc(pCaller);
+        const char* home = getenv("HOME");
+        std::string path = std::string(home ? home : ".") + "/FreqmodGrid-trace.json";
+        Trace::writeChromeJson(path.c_str());
+      }, "TRACE", style));
+#endif
+
     // Randomize button
     pGraphics->AttachControl(new IVButtonControl(IRECT(340, y + 25, 430, y + 50),
       SplashClickActionFunc, "RND", style));
@@ -217,10 +255,110 @@ void FreqmodGrid::ProcessMidiMsg(const IMidiMsg& msg)
 void FreqmodGrid::OnReset()
 {
   mDSP.Reset(GetSampleRate(), GetBlockSize());
+  UpdateLatency();
+}
+
+void FreqmodGrid::OnParamChange(int paramIdx, EParamSource source, int sampleOffset)
+{
+  // Recalled values reach the DSP together, from OnRestoreState
+  if (source == kPresetRecall)
+    return;
+  // Host automation with a sample offset is delivered from inside the host's process
+  // call, on the audio thread; everything else may come from any thread
+  const bool fromAudioThread = (source == kHost && sampleOffset >= 0);
+  mDSP.SetParam(paramIdx, GetParam(paramIdx)->Value(), sampleOffset, fromAudioThread);
+  if (paramIdx == kParamOversample || paramIdx == kParamOversampleFilter)
+    UpdateLatency();
+}
+
+void FreqmodGrid::OnRestoreState()
+{
+  // One snapshot instead of an OnParamChange per parameter
+  SendStateToDSP();
+
+  // The editor's controls follow the restored values
+  Plugin::OnRestoreState();
+}
+
+void FreqmodGrid::LoadPreset(const Preset& preset)
+{
+  for (const PresetParameter& param : preset.parameters)
+  {
+    for (int i = 0; i < kNumParams; i++)
+    {
+      if (param.name == GetParam(i)->GetName())
+      {
+        GetParam(i)->Set(param.value);
+        break;
+      }
+    }
+  }
+
+  SendStateToDSP();
+
+  // Host automation lanes and the editor's controls follow the new values
+  DirtyParametersFromUI();
+  SendCurrentParamValuesFromDelegate();
+}
+
+void FreqmodGrid::SendStateToDSP()
+{
+  double values[kNumParams];
+  for (int i = 0; i < kNumParams; i++)
+    values[i] = GetParam(i)->Value();
+  mDSP.SetState(values);
+  UpdateLatency();
+}
+
+// Meter only while the readout is visible; closed, the audio thread skips it
+void FreqmodGrid::OnUIOpen()
+{
+  Plugin::OnUIOpen();
+  mDSP.mMeter.setEnabled(true);
+}
+
+void FreqmodGrid::OnUIClose()
+{
+  mDSP.mMeter.setEnabled(false);
+  Plugin::OnUIClose();
+}
+
+void FreqmodGrid::OnIdle()
+{
+#if IPLUG_EDITOR
+  IGraphics* pGraphics = GetUI();
+  PerformanceStats stats;
+  if (!pGraphics || !mDSP.mMeter.read(stats))
+    return;
+
+  auto setLine = [pGraphics](int tag, const char* str, const IColor& color) {
+    if (auto* control = dynamic_cast<ITextControl*>(pGraphics->GetControlWithTag(tag)))
+    {
+      control->SetText(IText(10, EAlign::Near, color));
+      control->SetStr(str);
+    }
+  };
+  const IColor normal(255, 200, 200, 210);
+  const IColor warning(255, 255, 80, 80);
+
+  char str[32];
+  snprintf(str, sizeof(str), "%d%% pk %d%%", static_cast<int>(stats.load * 100.f + 0.5f),
+           static_cast<int>(stats.peakLoad * 100.f + 0.5f));
+  setLine(kCtrlTagLoad, str, stats.overruns > 0 ? warning : normal);
+  snprintf(str, sizeof(str), "%d voices", stats.activeVoices);
+  setLine(kCtrlTagVoices, str, normal);
+  snprintf(str, sizeof(str), "%.0f steals/s", stats.stealsPerSecond);
+  setLine(kCtrlTagSteals, str, stats.stealsPerSecond > 0.f ? warning : normal);
+  snprintf(str, sizeof(str), "%dx %s", stats.oversampleRatio, stats.denormalsFlushed ? "FTZ" : "no FTZ");
+  setLine(kCtrlTagEngine, str, stats.denormalsFlushed ? normal : warning);
+#endif
 }
 
-void FreqmodGrid::OnParamChange(int paramIdx)
+void FreqmodGrid::UpdateLatency()
 {
-  mDSP.SetParam(paramIdx, GetParam(paramIdx)->Value());
+  int latency = FreqmodGridDSP<sample>::LatencyFor(GetParam(kParamOversample)->Value(),
+                                                   GetParam(kParamOversampleFilter)->Value());
+  if (latency != GetLatency())
+    SetLatency(latency);
 }
 #endif
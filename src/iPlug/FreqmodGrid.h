@@ -4,6 +4,16 @@
 
 const int kNumPresets = 1;
 
+// Controls updated from the plugin rather than through a parameter
+enum ECtrlTags
+{
+  kCtrlTagLoad = 0,
+  kCtrlTagVoices,
+  kCtrlTagSteals,
+  kCtrlTagEngine,
+  kNumCtrlTags
+};
+
 #if IPLUG_DSP
 #include "FreqmodGrid_DSP.h"
 #include "PresetManager.h"
@@ -22,9 +32,27 @@ public:
   void ProcessBlock(sample** inputs, sample** outputs, int nFrames) override;
   void ProcessMidiMsg(const IMidiMsg& msg) override;
   void OnReset() override;
-  void OnParamChange(int paramIdx) override;
+  void OnParamChange(int paramIdx, EParamSource source, int sampleOffset) override;
+  void OnUIOpen() override;
+  void OnUIClose() override;
+  void OnIdle() override;
+
+  // Host state restore (project load) and preset recall: every parameter has been
+  // set with an OnParamChange from kPresetRecall, which is skipped; the DSP gets the
+  // whole state here as one snapshot, applied at the start of the next block
+  void OnRestoreState() override;
+
+  // Preset browser: set the parameters a preset names (by parameter name) and hand
+  // the DSP the whole resulting state as one snapshot, the same way as a restore
+  void LoadPreset(const Preset& preset);
 
 private:
+  // Build the current parameter values into one snapshot for the DSP (off the audio
+  // thread) and report the resulting latency
+  void SendStateToDSP();
+  // Report the oversampling filter delay to the host
+  void UpdateLatency();
+
   FreqmodGridDSP<sample> mDSP {16};
   PresetManager mPresetManager;
 #endif
@@ -2,7 +2,15 @@
 
 #include "MidiSynth.h"
 #include "../DSP/FMEngine.h"
-#include "../DSP/Oversampler.h"
+#include "../DSP/SpscQueue.h"
+#include "../DSP/DenormalGuard.h"
+#include "../DSP/PerformanceMeter.h"
+#include "../DSP/Trace.h"
+#include "../DSP/RealtimeCheck.h"
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <mutex>
 
 using namespace iplug;
 
@@ -52,6 +60,11 @@ enum EParams
   // Master
   kParamMasterVolume,
   kParamOversample,
+  // Filter (added after the original set so saved parameter indices stay valid)
+  kParamFilterTopology,
+  kParamPolyphony,
+  kParamOversampleFilter,
+  kParamRenderThreads,
   kNumParams
 };
 
@@ -64,53 +77,85 @@ class FreqmodGridDSP
 public:
   FreqmodGridDSP(int /*nVoices*/)
   {
+    mState = mEngine.getState();
   }
 
   void ProcessBlock(T** inputs, T** outputs, int nOutputs, int nFrames,
                     double qnPos = 0., bool transportIsRunning = false, double tempo = 120.)
   {
+    DenormalGuard denormalGuard;
+    FMG_REALTIME_SCOPE();
+    FMG_TRACE_THREAD("audio");
+    FMG_TRACE_SCOPE("FreqmodGridDSP::ProcessBlock");
+    // Timed only while someone is watching the meter
+    const bool metering = mMeter.shouldMeasure();
+    const auto blockStart = metering ? std::chrono::steady_clock::now()
+                                     : std::chrono::steady_clock::time_point();
+
     // Clear outputs
     for (int i = 0; i < nOutputs; i++)
       memset(outputs[i], 0, nFrames * sizeof(T));
 
-    // Process any queued MIDI messages
-    while (!mMidiQueue.Empty())
+    // Render up to each MIDI event and handle it at its sample. Parameter changes
+    // reach the voices at the engine's next control update, so the render is only
+    // split at the update after a change, and all changes up to it go together.
+    const int numChanges = CollectParams();
+    int next = 0;
+    int pos = 0;
+    while (pos < nFrames)
     {
-      IMidiMsg msg = mMidiQueue.Peek();
-      if (msg.mOffset > nFrames) break;
-      mMidiQueue.Remove();
-
-      if (msg.StatusMsg() == IMidiMsg::kNoteOn && msg.Velocity() > 0)
-        mEngine.noteOn(msg.NoteNumber(), msg.Velocity() / 127.0f);
-      else if (msg.StatusMsg() == IMidiMsg::kNoteOff ||
-               (msg.StatusMsg() == IMidiMsg::kNoteOn && msg.Velocity() == 0))
-        mEngine.noteOff(msg.NoteNumber());
-    }
+      for (; next < numChanges && mBlockParams[next].offset <= pos; next++)
+        ApplyParam(mBlockParams[next].paramIdx, mBlockParams[next].value);
+      while (!mMidiQueue.Empty() && mMidiQueue.Peek().mOffset <= pos)
+      {
+        HandleMidiMsg(mMidiQueue.Peek());
+        mMidiQueue.Remove();
+      }
 
-    // FMEngine processes into float buffers
-    // We need temporary float buffers if T is double
-    if constexpr (std::is_same_v<T, float>)
-    {
-      mEngine.process(outputs[0], (nOutputs > 1) ? outputs[1] : outputs[0], nFrames);
+      int end = nFrames;
+      if (next < numChanges && mBlockParams[next].offset < end)
+        end = std::min(end, pos + mEngine.nextControlUpdate(mBlockParams[next].offset - pos));
+      if (!mMidiQueue.Empty() && mMidiQueue.Peek().mOffset < end)
+        end = mMidiQueue.Peek().mOffset;
+      Render(outputs, nOutputs, pos, end - pos);
+      pos = end;
     }
-    else
+
+    // MIDI timed past this block stays queued, relative to the next one
+    mMidiQueue.Flush(nFrames);
+
+    // Changes timed past the end of this block take effect now
+    for (; next < numChanges; next++)
+      ApplyParam(mBlockParams[next].paramIdx, mBlockParams[next].value);
+
+    // A queue overflowed at some point: bring every parameter up to date
+    if (mParamsOverflowed.exchange(false, std::memory_order_acquire))
     {
-      // For double precision, use intermediate float buffers
-      mTempL.resize(nFrames);
-      mTempR.resize(nFrames);
-      mEngine.process(mTempL.data(), mTempR.data(), nFrames);
-      for (int s = 0; s < nFrames; s++)
+      for (int i = 0; i < kNumParams; i++)
       {
-        outputs[0][s] = static_cast<T>(mTempL[s]);
-        if (nOutputs > 1)
-          outputs[1][s] = static_cast<T>(mTempR[s]);
+        double value = mLatestParams[i].load(std::memory_order_relaxed);
+        if (!SetStateParam(mState, i, value))
+          ApplyParam(i, value);
       }
+      mEngine.applyState(mState);
+    }
+
+    if (metering)
+    {
+      double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - blockStart).count();
+      mMeter.addBlock(seconds, nFrames, mSampleRate, mEngine.getNumActiveVoices(), mEngine.getNumSteals(),
+                      DenormalGuard::isFlushing(), mEngine.getOversampleRatio());
     }
   }
 
   void Reset(double sampleRate, int blockSize)
   {
+    mSampleRate = sampleRate;
     mEngine.setSampleRate(static_cast<float>(sampleRate));
+    // Render helpers, only used while many voices play. Starting threads is not
+    // real-time safe, so a change of the parameter waits for the next reset.
+    double renderThreads = mLatestParams[kParamRenderThreads].load(std::memory_order_relaxed);
+    mEngine.setRenderThreads(static_cast<int>(renderThreads));
     mMidiQueue.Resize(blockSize);
   }
 
@@ -119,64 +164,315 @@ public:
     mMidiQueue.Add(msg);
   }
 
-  void SetParam(int paramIdx, double value)
+  // True while the engine is idle and the last block was all zeros, for plugin
+  // formats that can flag silent output to the host
+  bool IsSilent() const { return mEngine.isIdle(); }
+
+  static OversampleMode OversampleModeFor(double value)
+  {
+    return (value < 0.5) ? OversampleMode::Off : (value < 1.5) ? OversampleMode::x2
+         : (value < 2.5) ? OversampleMode::x4 : OversampleMode::Auto;
+  }
+
+  static OversampleFilter OversampleFilterFor(double value)
+  {
+    return (value < 0.5) ? OversampleFilter::FIR : OversampleFilter::IIR;
+  }
+
+  // Output delay for the given oversampling parameter values, in samples
+  static int LatencyFor(double oversample, double filter)
+  {
+    float latency = Oversampler::latencyFor(OversampleModeFor(oversample), OversampleFilterFor(filter));
+    return static_cast<int>(latency + 0.5f);
+  }
+
+  // Queue a parameter change for the audio thread. sampleOffset is the position in
+  // the next block where it takes effect (< 0 for the start). fromAudioThread says
+  // whether the caller is the audio thread, between blocks (host automation with a
+  // sample offset): those changes have a queue of their own and never block. Every
+  // other thread (editor, host state restore) takes turns on a second queue, so each
+  // queue keeps a single producer.
+  void SetParam(int paramIdx, double value, int sampleOffset = -1, bool fromAudioThread = false)
+  {
+    if (paramIdx < 0 || paramIdx >= kNumParams) return;
+    mLatestParams[paramIdx].store(value, std::memory_order_relaxed);
+    if (fromAudioThread)
+    {
+      PushParam(mAudioParamQueue, {paramIdx, value, sampleOffset});
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mUIProducerMutex);
+    PushParam(mUIParamQueue, {paramIdx, value, sampleOffset});
+  }
+
+  // Queue a whole set of parameter values (kNumParams, in parameter units), such as
+  // a preset, to take effect together at the start of the next block. The engine
+  // snapshot is built here, on the calling thread; the audio thread only swaps it
+  // in and updates what changed. Call from any thread but the audio thread.
+  void SetState(const double* values)
+  {
+    EngineState state;   // every sound field is a parameter; none is read from the engine
+    std::lock_guard<std::mutex> lock(mUIProducerMutex);
+    for (int i = 0; i < kNumParams; i++)
+    {
+      mLatestParams[i].store(values[i], std::memory_order_relaxed);
+      if (!SetStateParam(state, i, values[i]))
+        PushParam(mUIParamQueue, {i, values[i], -1});
+    }
+    const uint32_t sequence = ++mStateSequence;
+    if (!mStateQueue.push({sequence, state}) ||
+        !mUIParamQueue.push({kStateChange, static_cast<double>(sequence), -1}))
+      mParamsOverflowed.store(true, std::memory_order_release);
+  }
+
+  // Write a parameter value into a snapshot, in engine units. Returns false for
+  // parameters that are engine configuration rather than sound (polyphony,
+  // oversampling, render threads).
+  static bool SetStateParam(EngineState& state, int paramIdx, double value)
   {
     switch (paramIdx)
     {
       // Operator params: each group of 3 is ratio, level, feedback
-      case kParamOp1Ratio:    mEngine.setOperatorRatio(0, (float)value); break;
-      case kParamOp1Level:    mEngine.setOperatorLevel(0, (float)value / 100.0); break;
-      case kParamOp1Feedback: mEngine.setOperatorFeedback(0, (float)value / 100.0); break;
-      case kParamOp2Ratio:    mEngine.setOperatorRatio(1, (float)value); break;
-      case kParamOp2Level:    mEngine.setOperatorLevel(1, (float)value / 100.0); break;
-      case kParamOp2Feedback: mEngine.setOperatorFeedback(1, (float)value / 100.0); break;
-      case kParamOp3Ratio:    mEngine.setOperatorRatio(2, (float)value); break;
-      case kParamOp3Level:    mEngine.setOperatorLevel(2, (float)value / 100.0); break;
-      case kParamOp3Feedback: mEngine.setOperatorFeedback(2, (float)value / 100.0); break;
-      case kParamOp4Ratio:    mEngine.setOperatorRatio(3, (float)value); break;
-      case kParamOp4Level:    mEngine.setOperatorLevel(3, (float)value / 100.0); break;
-      case kParamOp4Feedback: mEngine.setOperatorFeedback(3, (float)value / 100.0); break;
-      case kParamOp5Ratio:    mEngine.setOperatorRatio(4, (float)value); break;
-      case kParamOp5Level:    mEngine.setOperatorLevel(4, (float)value / 100.0); break;
-      case kParamOp5Feedback: mEngine.setOperatorFeedback(4, (float)value / 100.0); break;
-      case kParamOp6Ratio:    mEngine.setOperatorRatio(5, (float)value); break;
-      case kParamOp6Level:    mEngine.setOperatorLevel(5, (float)value / 100.0); break;
-      case kParamOp6Feedback: mEngine.setOperatorFeedback(5, (float)value / 100.0); break;
-
-      case kParamAlgorithm:   mEngine.setAlgorithm((int)value); break;
-
-      case kParamFilterType:    mEngine.setFilterType((int)value); break;
-      case kParamFilterCutoff:  mEngine.setFilterCutoff((float)value); break;
-      case kParamFilterRes:     mEngine.setFilterResonance((float)value / 100.0); break;
-
-      case kParamAttack:  mEngine.setAttack((float)value / 1000.0); break;  // ms -> seconds
-      case kParamDecay:   mEngine.setDecay((float)value / 1000.0); break;
-      case kParamSustain: mEngine.setSustain((float)value / 100.0); break;
-      case kParamRelease: mEngine.setRelease((float)value / 1000.0); break;
-
-      case kParamLFO1Rate:  mEngine.setLFORate(0, (float)value); break;
-      case kParamLFO1Depth: mEngine.setLFODepth(0, (float)value / 100.0); break;
-      case kParamLFO2Rate:  mEngine.setLFORate(1, (float)value); break;
-      case kParamLFO2Depth: mEngine.setLFODepth(1, (float)value / 100.0); break;
-
-      case kParamChorusRate:     mEngine.setChorusRate((float)value); break;
-      case kParamChorusDepth:    mEngine.setChorusDepth((float)value / 100.0); break;
-      case kParamDelayTime:      mEngine.setDelayTime((float)value / 1000.0); break;  // ms -> s
-      case kParamDelayFeedback:  mEngine.setDelayFeedback((float)value / 100.0); break;
-
-      case kParamMasterVolume: mEngine.setMasterVolume((float)value / 100.0); break;
-      case kParamOversample:   
-        if (value < 0.5) mOversampler.setMode(OversampleMode::Off);
-        else if (value < 1.5) mOversampler.setMode(OversampleMode::x2);
-        else mOversampler.setMode(OversampleMode::x4);
+      case kParamOp1Ratio:    state.operators[0].ratio = (float)value; break;
+      case kParamOp1Level:    state.operators[0].level = (float)value / 100.0; break;
+      case kParamOp1Feedback: state.operators[0].feedback = (float)value / 100.0; break;
+      case kParamOp2Ratio:    state.operators[1].ratio = (float)value; break;
+      case kParamOp2Level:    state.operators[1].level = (float)value / 100.0; break;
+      case kParamOp2Feedback: state.operators[1].feedback = (float)value / 100.0; break;
+      case kParamOp3Ratio:    state.operators[2].ratio = (float)value; break;
+      case kParamOp3Level:    state.operators[2].level = (float)value / 100.0; break;
+      case kParamOp3Feedback: state.operators[2].feedback = (float)value / 100.0; break;
+      case kParamOp4Ratio:    state.operators[3].ratio = (float)value; break;
+      case kParamOp4Level:    state.operators[3].level = (float)value / 100.0; break;
+      case kParamOp4Feedback: state.operators[3].feedback = (float)value / 100.0; break;
+      case kParamOp5Ratio:    state.operators[4].ratio = (float)value; break;
+      case kParamOp5Level:    state.operators[4].level = (float)value / 100.0; break;
+      case kParamOp5Feedback: state.operators[4].feedback = (float)value / 100.0; break;
+      case kParamOp6Ratio:    state.operators[5].ratio = (float)value; break;
+      case kParamOp6Level:    state.operators[5].level = (float)value / 100.0; break;
+      case kParamOp6Feedback: state.operators[5].feedback = (float)value / 100.0; break;
+
+      case kParamAlgorithm:   state.algorithm = (int)value; break;
+
+      case kParamFilterType:    state.filterType = (int)value; break;
+      case kParamFilterCutoff:  state.filterCutoff = (float)value; break;
+      case kParamFilterRes:     state.filterResonance = (float)value / 100.0; break;
+      case kParamFilterTopology: state.filterTopology = (int)value; break;
+
+      case kParamAttack:  state.attack = (float)value / 1000.0; break;  // ms -> seconds
+      case kParamDecay:   state.decay = (float)value / 1000.0; break;
+      case kParamSustain: state.sustain = (float)value / 100.0; break;
+      case kParamRelease: state.release = (float)value / 1000.0; break;
+
+      case kParamLFO1Rate:  state.lfos[0].rate = (float)value; break;
+      case kParamLFO1Depth: state.lfos[0].depth = (float)value / 100.0; break;
+      case kParamLFO2Rate:  state.lfos[1].rate = (float)value; break;
+      case kParamLFO2Depth: state.lfos[1].depth = (float)value / 100.0; break;
+
+      case kParamChorusRate:     state.chorusRate = (float)value; break;
+      case kParamChorusDepth:    state.chorusDepth = (float)value / 100.0; break;
+      case kParamDelayTime:      state.delayTime = (float)value / 1000.0; break;  // ms -> s
+      case kParamDelayFeedback:  state.delayFeedback = (float)value / 100.0; break;
+
+      case kParamMasterVolume: state.masterVolume = (float)value / 100.0; break;
+      default: return false;
+    }
+    return true;
+  }
+
+private:
+  // Marks a queued EngineState in the parameter queue; the value is its sequence number
+  static constexpr int kStateChange = kNumParams;
+
+  struct StateChange
+  {
+    uint32_t sequence;
+    EngineState state;
+  };
+
+  struct ParamChange
+  {
+    int paramIdx;
+    double value;
+    int offset;
+  };
+
+  static constexpr int kParamQueueSize = 1024;
+  typedef SpscQueue<ParamChange, kParamQueueSize> ParamQueue;
+
+  void PushParam(ParamQueue& queue, const ParamChange& change)
+  {
+    if (!queue.push(change))
+      mParamsOverflowed.store(true, std::memory_order_release);
+  }
+
+  // Move everything queued so far into mBlockParams, sorted by offset. Hosts deliver
+  // a block's automation grouped by parameter rather than by time, so neither queue
+  // is in offset order. The sort is stable (same-offset changes keep their queue
+  // order, UI queue first) and in place: an insertion sort, which is also the fast
+  // choice for the few, mostly ordered changes of a typical block.
+  int CollectParams()
+  {
+    int count = 0;
+    for (ParamQueue* queue : {&mUIParamQueue, &mAudioParamQueue})
+    {
+      while (const ParamChange* change = queue->peek())
+      {
+        mBlockParams[count++] = *change;
+        queue->pop();
+      }
+    }
+    for (int i = 1; i < count; i++)
+    {
+      const ParamChange change = mBlockParams[i];
+      int j = i;
+      for (; j > 0 && mBlockParams[j - 1].offset > change.offset; j--)
+        mBlockParams[j] = mBlockParams[j - 1];
+      mBlockParams[j] = change;
+    }
+    return count;
+  }
+
+  // FMEngine writes the host's sample type directly, float or double
+  void Render(T** outputs, int nOutputs, int start, int nFrames)
+  {
+    // Idle engine: the outputs were cleared at the top of ProcessBlock
+    if (mEngine.isIdle())
+      return;
+
+    mEngine.process(outputs[0] + start, (nOutputs > 1) ? outputs[1] + start : outputs[0] + start,
+                    nFrames);
+  }
+
+  void HandleMidiMsg(const IMidiMsg& msg)
+  {
+    int ch = msg.Channel();
+    switch (msg.StatusMsg())
+    {
+      case IMidiMsg::kNoteOn:
+        if (msg.Velocity() > 0)
+        {
+          int note = msg.NoteNumber();
+          mEngine.noteOn(note, msg.Velocity() / 127.0f);
+          mChannelNotes[ch].set(note);
+          // Pick up the channel's current bend and pressure
+          if (mChannelBend[ch] != 0.0f)
+            mEngine.setVoiceBend(note, mChannelBend[ch]);
+          mEngine.setVoicePressure(note, mChannelPressure[ch]);
+          break;
+        }
+        [[fallthrough]];
+      case IMidiMsg::kNoteOff:
+        mEngine.noteOff(msg.NoteNumber());
+        mChannelNotes[ch].reset(msg.NoteNumber());
+        break;
+      case IMidiMsg::kPitchWheel:
+        mChannelBend[ch] = static_cast<float>(msg.PitchWheel()) * kPitchBendRange * 100.0f;
+        ForEachChannelNote(ch, [&](int note) { mEngine.setVoiceBend(note, mChannelBend[ch]); });
+        break;
+      case IMidiMsg::kChannelAftertouch:
+        mChannelPressure[ch] = msg.ChannelAfterTouch() / 127.0f;
+        ForEachChannelNote(ch, [&](int note) { mEngine.setVoicePressure(note, mChannelPressure[ch]); });
+        break;
+      case IMidiMsg::kPolyAftertouch:
+        mEngine.setVoicePressure(msg.NoteNumber(), msg.PolyAfterTouch() / 127.0f);
         break;
+      case IMidiMsg::kControlChange:
+        switch (msg.mData1)
+        {
+          case 74:  // MPE slide
+            ForEachChannelNote(ch, [&](int note) { mEngine.setVoiceSlide(note, msg.mData2 / 127.0f); });
+            break;
+          case 120:  // all sound off
+          case 123:  // all notes off
+            ForEachChannelNote(ch, [&](int note) { mEngine.noteOff(note); });
+            mChannelNotes[ch].reset();
+            break;
+          default: break;
+        }
+        break;
+      default: break;
+    }
+  }
+
+  // f(note) for each note held on a MIDI channel
+  template<typename F>
+  void ForEachChannelNote(int ch, F f)
+  {
+    if (mChannelNotes[ch].none()) return;
+    for (int note = 0; note < 128; note++)
+    {
+      if (mChannelNotes[ch].test(note))
+        f(note);
+    }
+  }
+
+  void ApplyParam(int paramIdx, double value)
+  {
+    if (paramIdx == kStateChange)
+    {
+      ApplyStateChange(static_cast<uint32_t>(value));
+      return;
+    }
+    // Sound parameters go through the snapshot, so only a real change reaches the voices
+    if (SetStateParam(mState, paramIdx, value))
+    {
+      mEngine.applyState(mState);
+      return;
+    }
+    switch (paramIdx)
+    {
+      case kParamPolyphony:    mEngine.setPolyphony((int)value); break;
+      case kParamOversample:       mEngine.setOversampling(OversampleModeFor(value)); break;
+      case kParamOversampleFilter: mEngine.setOversampleFilter(OversampleFilterFor(value)); break;
+      // kParamRenderThreads: applied by Reset, off the audio thread
       default: break;
     }
   }
 
+  // Apply the snapshot queued with this sequence number. Older snapshots whose
+  // marker was lost to a full parameter queue are skipped; the overflow path has
+  // already brought every parameter up to date.
+  void ApplyStateChange(uint32_t sequence)
+  {
+    const StateChange* change = mStateQueue.peek();
+    while (change && static_cast<int32_t>(change->sequence - sequence) < 0)
+    {
+      mStateQueue.pop();
+      change = mStateQueue.peek();
+    }
+    if (!change || change->sequence != sequence)
+      return;
+    mState = change->state;
+    mStateQueue.pop();
+    mEngine.applyState(mState);
+  }
+
 public:
   FMEngine mEngine;
   IMidiQueue mMidiQueue;
-  std::vector<float> mTempL, mTempR;
-  Oversampler<float> mOversampler;
+  // Parameter changes, applied by ProcessBlock: those made on the audio thread (host
+  // automation) and those from every other thread, which hold mUIProducerMutex to
+  // push. If a queue fills up, the latest values are applied in full at the end of
+  // the next block.
+  ParamQueue mAudioParamQueue;
+  ParamQueue mUIParamQueue;
+  std::mutex mUIProducerMutex;
+  ParamChange mBlockParams[2 * kParamQueueSize];   // this block's changes (CollectParams)
+  std::atomic<double> mLatestParams[kNumParams] {};
+  std::atomic<bool> mParamsOverflowed {false};
+  // Whole-state changes (SetState), each marked in mUIParamQueue so it keeps its place
+  // among the single changes. mState mirrors the engine's sound settings (audio thread).
+  SpscQueue<StateChange, 4> mStateQueue;
+  uint32_t mStateSequence = 0;   // guarded by mUIProducerMutex
+  EngineState mState;
+  // Block timing and engine state for the editor's DSP load readout
+  PerformanceMeter mMeter;
+  double mSampleRate = 48000.;
+  // Per-channel MIDI state: held notes, pitch bend (cents) and channel pressure.
+  // Bend and pressure follow the notes held on the channel.
+  static constexpr float kPitchBendRange = 2.0f;  // semitones
+  std::bitset<128> mChannelNotes[16];
+  float mChannelBend[16] = {};
+  float mChannelPressure[16] = {};
 };
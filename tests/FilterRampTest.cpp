@@ -0,0 +1,96 @@
+// FilterRampTest.cpp - A resonance change glides in instead of stepping
+//
+// With LFO2 depth 0 the modulated cutoff never moves, so the control update only
+// has the new resonance to pick up. Each case is rendered three times: unchanged,
+// with the resonance change, and with the same change plus a filter type set to its
+// current value, which makes the voices recompute their coefficients outright. Over
+// the first samples after the change the glide must stay well below the step; a
+// filter that jumps to the new coefficients matches it exactly.
+#include "DSP/FMEngine.h"
+#include "DSP/DenormalGuard.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const float SAMPLE_RATE = 48000.0f;
+const int BLOCK_SIZE = 64;
+const int NUM_BLOCKS = 100;
+const int CHANGE_BLOCK = 50;
+const int WINDOW = 4;             // samples compared after the change takes effect
+const float MAX_RATIO = 0.25f;    // glide / step over the window
+
+enum class Change { None, Resonance, ResonanceStep };
+
+std::vector<float> render(Change change, bool voiceBank, int topology, int type) {
+    auto engine = std::make_unique<FMEngine>();
+    engine->setSampleRate(SAMPLE_RATE);
+    engine->setVoiceBankEnabled(voiceBank);
+    engine->setFilterTopology(topology);
+    engine->setFilterType(type);
+    for (int op = 0; op < FMEngine::NUM_OPERATORS; ++op) engine->setOperatorLevel(op, 0.5f);
+    engine->setLFODepth(1, 0.0f);
+    engine->setFilterCutoff(800.0f);
+    engine->setFilterResonance(0.1f);
+    engine->setSustain(1.0f);
+    engine->noteOn(45, 1.0f);
+
+    std::vector<float> output;
+    std::vector<float> left(BLOCK_SIZE), right(BLOCK_SIZE);
+    for (int block = 0; block < NUM_BLOCKS; ++block) {
+        if (block == CHANGE_BLOCK && change != Change::None) {
+            engine->setFilterResonance(0.9f);
+            if (change == Change::ResonanceStep) engine->setFilterType(type);
+        }
+        engine->process(left.data(), right.data(), BLOCK_SIZE);
+        output.insert(output.end(), left.begin(), left.end());
+    }
+    return output;
+}
+
+}
+
+int main() {
+    DenormalGuard denormalGuard;
+
+    int failures = 0;
+    for (int voiceBank = 0; voiceBank < 2; ++voiceBank) {
+        for (int topology = 0; topology < 2; ++topology) {
+            for (int type = 0; type < 2; ++type) {
+                std::vector<float> unchanged = render(Change::None, voiceBank, topology, type);
+                std::vector<float> glide = render(Change::Resonance, voiceBank, topology, type);
+                std::vector<float> step = render(Change::ResonanceStep, voiceBank, topology, type);
+
+                // The control update that picks the change up
+                size_t onset = CHANGE_BLOCK * BLOCK_SIZE;
+                while (onset < step.size() && step[onset] == unchanged[onset]) ++onset;
+                if (onset + WINDOW > step.size()) {
+                    std::printf("FAIL %s, %s, %s: the resonance change had no effect\n",
+                                voiceBank ? "bank" : "scalar", topology ? "SVF" : "biquad",
+                                type ? "highpass" : "lowpass");
+                    ++failures;
+                    continue;
+                }
+
+                float glideError = 0.0f, stepError = 0.0f;
+                for (size_t i = onset; i < onset + WINDOW; ++i) {
+                    glideError = std::max(glideError, std::fabs(glide[i] - unchanged[i]));
+                    stepError = std::max(stepError, std::fabs(step[i] - unchanged[i]));
+                }
+                if (glideError > MAX_RATIO * stepError) {
+                    std::printf("FAIL %s, %s, %s: resonance change steps (%g against %g)\n",
+                                voiceBank ? "bank" : "scalar", topology ? "SVF" : "biquad",
+                                type ? "highpass" : "lowpass", glideError, stepError);
+                    ++failures;
+                }
+            }
+        }
+    }
+
+    if (failures > 0) return 1;
+    std::printf("resonance changes glide in at every control update\n");
+    return 0;
+}
@@ -0,0 +1,178 @@
+// MidiFile.cpp - Standard MIDI File reader for the offline renderer
+#include "MidiFile.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+namespace {
+
+struct TickEvent {
+    uint64_t tick;
+    int order;        // position in the file, keeps simultaneous events in order
+    MidiEvent event;
+};
+
+struct TempoChange {
+    uint64_t tick;
+    double secondsPerTick;
+};
+
+class Reader {
+public:
+    Reader(const uint8_t* data, size_t size) : data_(data), size_(size), pos_(0) {}
+
+    bool atEnd() const { return pos_ >= size_; }
+    size_t position() const { return pos_; }
+    bool has(size_t n) const { return size_ - pos_ >= n; }
+
+    uint8_t byte() { return has(1) ? data_[pos_++] : 0; }
+    uint8_t peek() const { return has(1) ? data_[pos_] : 0; }
+    uint32_t bigEndian(int bytes) {
+        uint32_t v = 0;
+        for (int i = 0; i < bytes; ++i) v = (v << 8) | byte();
+        return v;
+    }
+    uint32_t variableLength() {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i) {
+            uint8_t b = byte();
+            v = (v << 7) | (b & 0x7F);
+            if (!(b & 0x80)) break;
+        }
+        return v;
+    }
+    void skip(size_t n) { pos_ = std::min(size_, pos_ + n); }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_;
+};
+
+// Data bytes following a channel status byte
+int dataBytes(uint8_t status) {
+    uint8_t type = status & 0xF0;
+    return (type == 0xC0 || type == 0xD0) ? 1 : 2;
+}
+
+bool readTrack(Reader& track, std::vector<TickEvent>& events, std::vector<TempoChange>& tempos,
+               int& order) {
+    uint64_t tick = 0;
+    uint8_t running = 0;
+    while (!track.atEnd()) {
+        tick += track.variableLength();
+        uint8_t status = track.peek();
+        if (status & 0x80) {
+            track.byte();
+        } else if (running) {
+            status = running;   // running status: reuse the last channel status
+        } else {
+            return false;
+        }
+
+        if (status == 0xFF) {
+            uint8_t type = track.byte();
+            uint32_t length = track.variableLength();
+            if (type == 0x51 && length == 3) {
+                uint32_t microsPerQuarter = track.bigEndian(3);
+                tempos.push_back({ tick, static_cast<double>(microsPerQuarter) });
+            } else {
+                track.skip(length);
+            }
+            if (type == 0x2F) break;   // end of track
+        } else if (status == 0xF0 || status == 0xF7) {
+            track.skip(track.variableLength());
+        } else if (status >= 0x80 && status < 0xF0) {
+            running = status;
+            MidiEvent event = { 0.0, status, 0, 0 };
+            event.data1 = track.byte() & 0x7F;
+            if (dataBytes(status) == 2) event.data2 = track.byte() & 0x7F;
+            events.push_back({ tick, order++, event });
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+bool readMidiFile(const std::string& path, std::vector<MidiEvent>& events, std::string& error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    Reader reader(data.data(), data.size());
+
+    if (reader.bigEndian(4) != 0x4D546864 || reader.bigEndian(4) < 6) {   // "MThd"
+        error = "not a Standard MIDI File";
+        return false;
+    }
+    int format = static_cast<int>(reader.bigEndian(2));
+    int numTracks = static_cast<int>(reader.bigEndian(2));
+    uint16_t division = static_cast<uint16_t>(reader.bigEndian(2));
+    if (format > 1) {
+        error = "SMF format 2 is not supported";
+        return false;
+    }
+
+    std::vector<TickEvent> tickEvents;
+    std::vector<TempoChange> tempos;
+    int order = 0;
+    for (int t = 0; t < numTracks && reader.has(8); ++t) {
+        uint32_t id = reader.bigEndian(4);
+        uint32_t length = reader.bigEndian(4);
+        if (!reader.has(length)) {
+            error = "truncated track";
+            return false;
+        }
+        if (id == 0x4D54726B) {   // "MTrk"
+            Reader track(data.data() + reader.position(), length);
+            if (!readTrack(track, tickEvents, tempos, order)) {
+                error = "malformed track " + std::to_string(t);
+                return false;
+            }
+        }
+        reader.skip(length);
+    }
+
+    // Seconds per tick, from the tempo map or a fixed SMPTE rate
+    std::stable_sort(tempos.begin(), tempos.end(),
+                     [](const TempoChange& a, const TempoChange& b) { return a.tick < b.tick; });
+    double fixedSecondsPerTick = 0.0;
+    if (division & 0x8000) {
+        int framesPerSecond = -static_cast<int8_t>(division >> 8);
+        int ticksPerFrame = division & 0xFF;
+        fixedSecondsPerTick = 1.0 / (framesPerSecond * ticksPerFrame);
+    } else {
+        for (TempoChange& tempo : tempos) tempo.secondsPerTick /= 1e6 * division;
+    }
+    double defaultSecondsPerTick = (division & 0x8000) ? fixedSecondsPerTick
+                                                       : 0.5 / std::max<int>(1, division);
+
+    std::sort(tickEvents.begin(), tickEvents.end(), [](const TickEvent& a, const TickEvent& b) {
+        return (a.tick != b.tick) ? a.tick < b.tick : a.order < b.order;
+    });
+
+    events.clear();
+    events.reserve(tickEvents.size());
+    size_t nextTempo = 0;
+    uint64_t lastTick = 0;
+    double seconds = 0.0;
+    double secondsPerTick = defaultSecondsPerTick;
+    for (TickEvent& e : tickEvents) {
+        if (!(division & 0x8000)) {
+            while (nextTempo < tempos.size() && tempos[nextTempo].tick <= e.tick) {
+                seconds += (tempos[nextTempo].tick - lastTick) * secondsPerTick;
+                lastTick = tempos[nextTempo].tick;
+                secondsPerTick = tempos[nextTempo].secondsPerTick;
+                ++nextTempo;
+            }
+        }
+        e.event.time = seconds + (e.tick - lastTick) * secondsPerTick;
+        events.push_back(e.event);
+    }
+    return true;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Channel message from a Standard MIDI File, timed in seconds from the start
+struct MidiEvent {
+    double time;
+    uint8_t status;   // including the channel
+    uint8_t data1;
+    uint8_t data2;
+};
+
+// Read an SMF (format 0 or 1) into one list of channel events, merged across tracks
+// and sorted by time. Tempo changes are applied from any track; SMPTE time
+// divisions are supported. Returns false with a message in error on failure.
+bool readMidiFile(const std::string& path, std::vector<MidiEvent>& events, std::string& error);
@@ -0,0 +1,241 @@
+// PresetFile.cpp - Preset and parameter files for the offline renderer
+#include "PresetFile.h"
+#include "DSP/FMEngine.h"
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <sstream>
+
+namespace {
+
+// Minimal JSON reader that flattens every scalar to a dotted key path. Strings are
+// taken as-is (no escapes beyond \" and \\), which covers preset files.
+class JsonFlattener {
+public:
+    JsonFlattener(const std::string& text, PresetValues& out) : text_(text), pos_(0), out_(out) {}
+
+    bool parse() {
+        if (!value("")) return false;
+        skipSpace();
+        return pos_ == text_.size();
+    }
+
+private:
+    void skipSpace() {
+        while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) ++pos_;
+    }
+
+    bool consume(char c) {
+        skipSpace();
+        if (pos_ < text_.size() && text_[pos_] == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    bool string(std::string& s) {
+        if (!consume('"')) return false;
+        s.clear();
+        while (pos_ < text_.size() && text_[pos_] != '"') {
+            if (text_[pos_] == '\\' && pos_ + 1 < text_.size()) ++pos_;
+            s += text_[pos_++];
+        }
+        return consume('"');
+    }
+
+    static std::string join(const std::string& path, const std::string& key) {
+        return path.empty() ? key : path + "." + key;
+    }
+
+    bool value(const std::string& path) {
+        skipSpace();
+        if (pos_ >= text_.size()) return false;
+        char c = text_[pos_];
+        if (c == '{') {
+            ++pos_;
+            if (consume('}')) return true;
+            do {
+                std::string key;
+                if (!string(key) || !consume(':') || !value(join(path, key))) return false;
+            } while (consume(','));
+            return consume('}');
+        }
+        if (c == '[') {
+            ++pos_;
+            if (consume(']')) return true;
+            int index = 1;
+            do {
+                if (!value(join(path, std::to_string(index++)))) return false;
+            } while (consume(','));
+            return consume(']');
+        }
+        if (c == '"') {
+            std::string s;
+            if (!string(s)) return false;
+            out_[path] = s;
+            return true;
+        }
+        size_t start = pos_;
+        while (pos_ < text_.size() && (std::isalnum(static_cast<unsigned char>(text_[pos_])) ||
+                                       text_[pos_] == '.' || text_[pos_] == '-' || text_[pos_] == '+')) {
+            ++pos_;
+        }
+        if (pos_ == start) return false;
+        out_[path] = text_.substr(start, pos_ - start);
+        return true;
+    }
+
+    const std::string& text_;
+    size_t pos_;
+    PresetValues& out_;
+};
+
+bool readText(const std::string& path, std::string& text, std::string& error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    text = buffer.str();
+    return true;
+}
+
+std::string trim(const std::string& s) {
+    size_t start = s.find_first_not_of(" \t\r\n");
+    size_t end = s.find_last_not_of(" \t\r\n");
+    return (start == std::string::npos) ? std::string() : s.substr(start, end - start + 1);
+}
+
+// Setter for an indexed key ("operators.N.ratio"); index from 1
+using IndexedSetter = std::function<void(EngineState&, int, float)>;
+using Setter = std::function<void(EngineState&, float)>;
+
+const std::map<std::string, Setter>& setters() {
+    static const std::map<std::string, Setter> table = {
+        { "algorithm", [](EngineState& s, float v) { s.algorithm = static_cast<int>(v) - 1; } },
+        { "filter.type", [](EngineState& s, float v) { s.filterType = static_cast<int>(v); } },
+        { "filter.topology", [](EngineState& s, float v) { s.filterTopology = static_cast<int>(v); } },
+        { "filter.cutoff", [](EngineState& s, float v) { s.filterCutoff = v; } },
+        { "filter.resonance", [](EngineState& s, float v) { s.filterResonance = v; } },
+        { "envelope.attack", [](EngineState& s, float v) { s.attack = v; } },
+        { "envelope.decay", [](EngineState& s, float v) { s.decay = v; } },
+        { "envelope.sustain", [](EngineState& s, float v) { s.sustain = v; } },
+        { "envelope.release", [](EngineState& s, float v) { s.release = v; } },
+        { "effects.chorus_rate", [](EngineState& s, float v) { s.chorusRate = v; } },
+        { "effects.chorus_depth", [](EngineState& s, float v) { s.chorusDepth = v; } },
+        { "effects.delay_time", [](EngineState& s, float v) { s.delayTime = v; } },
+        { "effects.delay_feedback", [](EngineState& s, float v) { s.delayFeedback = v; } },
+        { "master_volume", [](EngineState& s, float v) { s.masterVolume = v; } },
+    };
+    return table;
+}
+
+// Indices past the engine's operators or LFOs are ignored
+const std::map<std::string, IndexedSetter>& indexedSetters() {
+    constexpr int OPS = EngineState::NUM_OPERATORS;
+    constexpr int LFOS = EngineState::NUM_LFOS;
+    static const std::map<std::string, IndexedSetter> table = {
+        { "operators.ratio", [](EngineState& s, int i, float v) { if (i < OPS) s.operators[i].ratio = v; } },
+        { "operators.level", [](EngineState& s, int i, float v) { if (i < OPS) s.operators[i].level = v; } },
+        { "operators.feedback", [](EngineState& s, int i, float v) { if (i < OPS) s.operators[i].feedback = v; } },
+        { "lfos.rate", [](EngineState& s, int i, float v) { if (i < LFOS) s.lfos[i].rate = v; } },
+        { "lfos.depth", [](EngineState& s, int i, float v) { if (i < LFOS) s.lfos[i].depth = v; } },
+        { "lfos.wave", [](EngineState& s, int i, float v) { if (i < LFOS) s.lfos[i].wave = static_cast<int>(v); } },
+    };
+    return table;
+}
+
+// Preset metadata that has no engine setting
+bool isMetadata(const std::string& key) {
+    return key == "name" || key == "category" || key == "isFavorite";
+}
+
+}
+
+bool loadPresetJson(const std::string& path, const std::string& name, PresetValues& values,
+                    std::string& error) {
+    std::string text;
+    if (!readText(path, text, error)) return false;
+
+    PresetValues all;
+    if (!JsonFlattener(text, all).parse()) {
+        error = "malformed JSON in " + path;
+        return false;
+    }
+    if (all.count("presets.1.name") == 0) {
+        for (const auto& [key, value] : all) values[key] = value;
+        return true;
+    }
+
+    // Preset collection: find the entry and strip its "presets.N." prefix
+    std::string prefix;
+    for (int i = 1; all.count("presets." + std::to_string(i) + ".name"); ++i) {
+        std::string candidate = "presets." + std::to_string(i) + ".";
+        if (name.empty() || all[candidate + "name"] == name) {
+            prefix = candidate;
+            break;
+        }
+    }
+    if (prefix.empty()) {
+        error = "no preset named \"" + name + "\" in " + path;
+        return false;
+    }
+    for (auto it = all.lower_bound(prefix); it != all.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+        values[it->first.substr(prefix.size())] = it->second;
+    }
+    return true;
+}
+
+bool loadParamsFile(const std::string& path, PresetValues& values, std::string& error) {
+    std::string text;
+    if (!readText(path, text, error)) return false;
+
+    std::istringstream lines(text);
+    std::string line;
+    for (int number = 1; std::getline(lines, line); ++number) {
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            error = path + ":" + std::to_string(number) + ": expected key = value";
+            return false;
+        }
+        values[trim(line.substr(0, equals))] = trim(line.substr(equals + 1));
+    }
+    return true;
+}
+
+bool applyPreset(FMEngine& engine, const PresetValues& values, std::string& error) {
+    EngineState state = engine.getState();
+    for (const auto& [key, text] : values) {
+        if (isMetadata(key)) continue;
+        float value = std::strtof(text.c_str(), nullptr);
+
+        auto plain = setters().find(key);
+        if (plain != setters().end()) {
+            plain->second(state, value);
+            continue;
+        }
+
+        // "group.N.field": look up "group.field" and pass N - 1
+        size_t first = key.find('.');
+        size_t second = (first == std::string::npos) ? first : key.find('.', first + 1);
+        if (second != std::string::npos) {
+            int index = std::atoi(key.substr(first + 1, second - first - 1).c_str());
+            auto indexed = indexedSetters().find(key.substr(0, first) + key.substr(second));
+            if (indexed != indexedSetters().end() && index >= 1) {
+                indexed->second(state, index - 1, value);
+                continue;
+            }
+        }
+
+        error = "unknown setting \"" + key + "\"";
+        return false;
+    }
+    engine.applyState(state);
+    return true;
+}
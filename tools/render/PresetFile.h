@@ -0,0 +1,26 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+class FMEngine;
+
+// Synth settings as flat keys: "algorithm", "operators.1.level", "filter.cutoff",
+// "envelope.attack", "effects.delay_time", "lfos.1.rate", "master_volume", ...
+// Arrays are numbered from 1, as on the panel. Values are in engine units (seconds,
+// Hz, 0-1 levels); the algorithm is 1-8.
+using PresetValues = std::map<std::string, std::string>;
+
+// Load one preset from a JSON file. A file with a "presets" array (the factory
+// preset format) selects the entry called name, or the first if name is empty; any
+// other file is a single preset object.
+bool loadPresetJson(const std::string& path, const std::string& name, PresetValues& values,
+                    std::string& error);
+
+// Load "key = value" lines, with the same keys as above; '#' starts a comment.
+// Later values replace earlier ones.
+bool loadParamsFile(const std::string& path, PresetValues& values, std::string& error);
+
+// Apply every recognised key to the engine, as one EngineState. Returns false and
+// names the first unknown key in error, leaving the engine unchanged.
+bool applyPreset(FMEngine& engine, const PresetValues& values, std::string& error);
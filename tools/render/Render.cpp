@@ -0,0 +1,317 @@
+// Render.cpp - Offline renderer: Standard MIDI File + preset -> WAV
+//
+// Drives FMEngine directly, with no plugin host, as fast as the machine allows.
+// Events are applied at their exact sample by splitting blocks, and handled the way
+// the plugin handles them (per-channel bend and pressure, MPE slide, all notes off).
+// After the last event the render continues until the engine goes idle (release
+// and effect tails) or the --tail limit is reached.
+//
+// In a build with FREQMODGRID_REALTIME_CHECK the event handling and process() calls
+// run in a real-time scope, and the render fails (exit code 3) if anything in them
+// allocated, locked or did file I/O.
+//
+//   FreqmodGridRender [options] input.mid output.wav
+#include "MidiFile.h"
+#include "PresetFile.h"
+#include "WavWriter.h"
+#include "DSP/FMEngine.h"
+#include "DSP/DenormalGuard.h"
+#include "DSP/Trace.h"
+#include "DSP/RealtimeCheck.h"
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+    std::string midiPath;
+    std::string wavPath;
+    std::string preset;       // file[:name]
+    std::string params;
+    float sampleRate = 48000.0f;
+    int blockSize = 512;
+    int polyphony = FMEngine::DEFAULT_POLYPHONY;
+    OversampleMode oversample = OversampleMode::Off;
+    OversampleFilter oversampleFilter = OversampleFilter::FIR;
+    int threads = 0;
+    float tail = 10.0f;       // longest render after the last event, seconds
+    int bits = 24;
+    std::string tracePath;
+    bool quiet = false;
+};
+
+void usage() {
+    std::cerr <<
+        "usage: FreqmodGridRender [options] input.mid output.wav\n"
+        "  --preset FILE[:NAME]    JSON preset, or a named entry of a preset collection\n"
+        "  --params FILE           key = value settings, applied after the preset\n"
+        "  --sample-rate HZ        output sample rate (default 48000)\n"
+        "  --block-size N          samples per process() call (default 512)\n"
+        "  --polyphony N           voices (default 16)\n"
+        "  --oversample MODE       off, 2x, 4x or auto (default off)\n"
+        "  --os-filter TYPE        fir or iir (default fir)\n"
+        "  --threads N             render helper threads (default 0)\n"
+        "  --tail SECONDS          longest render after the last event (default 10)\n"
+        "  --bits N                16, 24 or 32 (float) (default 24)\n"
+        "  --trace FILE            write a Chrome trace (builds with FREQMODGRID_TRACE)\n"
+        "  --quiet                 no summary on stdout\n";
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> const char* { return (i + 1 < argc) ? argv[++i] : nullptr; };
+        const char* value = nullptr;
+        if (arg == "--quiet") {
+            options.quiet = true;
+            continue;
+        }
+        if (arg.compare(0, 2, "--") != 0) {
+            positional.push_back(arg);
+            continue;
+        }
+        if (!(value = next())) {
+            std::cerr << "missing value for " << arg << "\n";
+            return false;
+        }
+        if (arg == "--preset") options.preset = value;
+        else if (arg == "--params") options.params = value;
+        else if (arg == "--sample-rate") options.sampleRate = std::strtof(value, nullptr);
+        else if (arg == "--block-size") options.blockSize = std::atoi(value);
+        else if (arg == "--polyphony") options.polyphony = std::atoi(value);
+        else if (arg == "--threads") options.threads = std::atoi(value);
+        else if (arg == "--tail") options.tail = std::strtof(value, nullptr);
+        else if (arg == "--bits") options.bits = std::atoi(value);
+        else if (arg == "--trace") options.tracePath = value;
+        else if (arg == "--oversample") {
+            std::string mode = value;
+            if (mode == "off") options.oversample = OversampleMode::Off;
+            else if (mode == "2x") options.oversample = OversampleMode::x2;
+            else if (mode == "4x") options.oversample = OversampleMode::x4;
+            else if (mode == "auto") options.oversample = OversampleMode::Auto;
+            else {
+                std::cerr << "unknown oversampling mode " << mode << "\n";
+                return false;
+            }
+        } else if (arg == "--os-filter") {
+            std::string filter = value;
+            if (filter == "fir") options.oversampleFilter = OversampleFilter::FIR;
+            else if (filter == "iir") options.oversampleFilter = OversampleFilter::IIR;
+            else {
+                std::cerr << "unknown oversampling filter " << filter << "\n";
+                return false;
+            }
+        } else {
+            std::cerr << "unknown option " << arg << "\n";
+            return false;
+        }
+    }
+    if (positional.size() != 2) return false;
+    options.midiPath = positional[0];
+    options.wavPath = positional[1];
+
+    if (options.sampleRate < 8000.0f || options.sampleRate > 384000.0f) {
+        std::cerr << "sample rate out of range\n";
+        return false;
+    }
+    if (options.blockSize < 1 || options.polyphony < 1 || options.threads < 0 || options.tail < 0.0f) {
+        std::cerr << "block size, polyphony, threads and tail must be positive\n";
+        return false;
+    }
+    if (options.bits != 16 && options.bits != 24 && options.bits != 32) {
+        std::cerr << "bits must be 16, 24 or 32\n";
+        return false;
+    }
+    if (!options.tracePath.empty() && !Trace::ENABLED) {
+        std::cerr << "--trace needs a build with FREQMODGRID_TRACE\n";
+        return false;
+    }
+    return true;
+}
+
+bool loadSettings(FMEngine& engine, const Options& options) {
+    PresetValues values;
+    std::string error;
+    if (!options.preset.empty()) {
+        // "file.json:Preset Name"; a colon in a Windows drive letter is not a separator
+        std::string path = options.preset, name;
+        size_t colon = path.rfind(':');
+        if (colon != std::string::npos && colon > 1) {
+            name = path.substr(colon + 1);
+            path = path.substr(0, colon);
+        }
+        if (!loadPresetJson(path, name, values, error)) {
+            std::cerr << error << "\n";
+            return false;
+        }
+    }
+    if (!options.params.empty() && !loadParamsFile(options.params, values, error)) {
+        std::cerr << error << "\n";
+        return false;
+    }
+    if (!applyPreset(engine, values, error)) {
+        std::cerr << error << "\n";
+        return false;
+    }
+    return true;
+}
+
+// MIDI to engine calls, matching FreqmodGridDSP::HandleMidiMsg
+class MidiPlayer {
+public:
+    static constexpr float PITCH_BEND_RANGE = 2.0f;   // semitones
+
+    explicit MidiPlayer(FMEngine& engine) : engine_(engine) {}
+
+    void handle(const MidiEvent& event) {
+        int ch = event.status & 0x0F;
+        int note = event.data1;
+        switch (event.status & 0xF0) {
+            case 0x90:
+                if (event.data2 > 0) {
+                    engine_.noteOn(note, event.data2 / 127.0f);
+                    notes_[ch].set(note);
+                    if (bend_[ch] != 0.0f) engine_.setVoiceBend(note, bend_[ch]);
+                    engine_.setVoicePressure(note, pressure_[ch]);
+                    break;
+                }
+                [[fallthrough]];
+            case 0x80:
+                engine_.noteOff(note);
+                notes_[ch].reset(note);
+                break;
+            case 0xE0: {
+                int wheel = (event.data2 << 7 | event.data1) - 8192;
+                bend_[ch] = wheel / 8192.0f * PITCH_BEND_RANGE * 100.0f;
+                forEachNote(ch, [&](int n) { engine_.setVoiceBend(n, bend_[ch]); });
+                break;
+            }
+            case 0xD0:
+                pressure_[ch] = event.data1 / 127.0f;
+                forEachNote(ch, [&](int n) { engine_.setVoicePressure(n, pressure_[ch]); });
+                break;
+            case 0xA0:
+                engine_.setVoicePressure(note, event.data2 / 127.0f);
+                break;
+            case 0xB0:
+                if (event.data1 == 74) {
+                    forEachNote(ch, [&](int n) { engine_.setVoiceSlide(n, event.data2 / 127.0f); });
+                } else if (event.data1 == 120 || event.data1 == 123) {
+                    forEachNote(ch, [&](int n) { engine_.noteOff(n); });
+                    notes_[ch].reset();
+                }
+                break;
+            default: break;
+        }
+    }
+
+private:
+    template<typename F>
+    void forEachNote(int ch, F f) {
+        for (int note = 0; note < 128 && notes_[ch].any(); ++note) {
+            if (notes_[ch].test(note)) f(note);
+        }
+    }
+
+    FMEngine& engine_;
+    std::bitset<128> notes_[16];
+    float bend_[16] = {};
+    float pressure_[16] = {};
+};
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    std::vector<MidiEvent> events;
+    std::string error;
+    if (!readMidiFile(options.midiPath, events, error)) {
+        std::cerr << options.midiPath << ": " << error << "\n";
+        return 1;
+    }
+
+    auto engine = std::make_unique<FMEngine>();
+    engine->setSampleRate(options.sampleRate);
+    engine->setPolyphony(options.polyphony);
+    engine->setRenderThreads(options.threads);
+    if (!loadSettings(*engine, options)) return 1;
+    engine->setOversampleFilter(options.oversampleFilter);
+    engine->setOversampling(options.oversample);
+
+    WavWriter wav;
+    if (!wav.open(options.wavPath, static_cast<int>(options.sampleRate), options.bits)) {
+        std::cerr << "cannot write " << options.wavPath << "\n";
+        return 1;
+    }
+
+    DenormalGuard denormalGuard;
+    FMG_TRACE_THREAD("render");
+    MidiPlayer player(*engine);
+    std::vector<float> left(options.blockSize), right(options.blockSize);
+    int64_t eventsEnd = events.empty() ? 0
+        : static_cast<int64_t>(events.back().time * options.sampleRate) + 1;
+    int64_t renderLimit = eventsEnd + static_cast<int64_t>(options.tail * options.sampleRate);
+
+    auto start = std::chrono::steady_clock::now();
+    int64_t frame = 0;
+    size_t next = 0;
+    while (frame < renderLimit && (frame < eventsEnd || !engine->isIdle())) {
+        int n = static_cast<int>(std::min<int64_t>(options.blockSize, renderLimit - frame));
+
+        // Split the block at each event
+        {
+            FMG_REALTIME_SCOPE();
+            int pos = 0;
+            while (pos < n) {
+                int end = n;
+                while (next < events.size()) {
+                    int64_t at = static_cast<int64_t>(events[next].time * options.sampleRate);
+                    if (at > frame + pos) {
+                        end = static_cast<int>(std::min<int64_t>(end, at - frame));
+                        break;
+                    }
+                    player.handle(events[next++]);
+                }
+                engine->process(left.data() + pos, right.data() + pos, end - pos);
+                pos = end;
+            }
+        }
+
+        wav.write(left.data(), right.data(), n);
+        frame += n;
+    }
+    wav.close();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!options.tracePath.empty() && !Trace::writeChromeJson(options.tracePath.c_str())) {
+        std::cerr << "cannot write " << options.tracePath << "\n";
+        return 1;
+    }
+
+    if (RealtimeCheck::getViolationCount() > 0) {
+        std::cerr << RealtimeCheck::getViolationCount() << " real-time violations while rendering\n";
+        return 3;
+    }
+
+    if (!options.quiet) {
+        double seconds = frame / options.sampleRate;
+        std::printf("%s: %.2f s of audio in %.3f s (%.1fx real time), %zu events\n",
+                    options.wavPath.c_str(), seconds, elapsed,
+                    (elapsed > 0.0) ? seconds / elapsed : 0.0, events.size());
+    }
+    return 0;
+}
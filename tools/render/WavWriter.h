@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Streams interleaved stereo to a RIFF WAVE file: 16 or 24-bit PCM, or 32-bit
+// float. The sizes in the header are filled in by close().
+class WavWriter {
+public:
+    WavWriter() : file_(nullptr), bits_(16), sampleRate_(48000), frames_(0) {}
+    ~WavWriter() { close(); }
+
+    WavWriter(const WavWriter&) = delete;
+    WavWriter& operator=(const WavWriter&) = delete;
+
+    bool open(const std::string& path, int sampleRate, int bits) {
+        if (bits != 16 && bits != 24 && bits != 32) return false;
+        file_ = std::fopen(path.c_str(), "wb");
+        if (!file_) return false;
+        bits_ = bits;
+        sampleRate_ = sampleRate;
+        frames_ = 0;
+        writeHeader();
+        return true;
+    }
+
+    void write(const float* left, const float* right, int numFrames) {
+        int bytesPerSample = bits_ / 8;
+        bytes_.resize(static_cast<size_t>(numFrames) * 2 * bytesPerSample);
+        uint8_t* out = bytes_.data();
+        for (int i = 0; i < numFrames; ++i) {
+            out = encode(left[i], out);
+            out = encode(right[i], out);
+        }
+        std::fwrite(bytes_.data(), 1, bytes_.size(), file_);
+        frames_ += numFrames;
+    }
+
+    void close() {
+        if (!file_) return;
+        std::fseek(file_, 0, SEEK_SET);
+        writeHeader();
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+
+private:
+    uint8_t* encode(float x, uint8_t* out) const {
+        if (bits_ == 32) {
+            uint32_t v;
+            static_assert(sizeof(v) == sizeof(x));
+            std::memcpy(&v, &x, sizeof(v));
+            return little(v, 4, out);
+        }
+        float scale = (bits_ == 16) ? 32767.0f : 8388607.0f;
+        int32_t v = static_cast<int32_t>(std::lrint(std::clamp(x, -1.0f, 1.0f) * scale));
+        return little(static_cast<uint32_t>(v), bits_ / 8, out);
+    }
+
+    static uint8_t* little(uint32_t v, int bytes, uint8_t* out) {
+        for (int i = 0; i < bytes; ++i) *out++ = static_cast<uint8_t>(v >> (8 * i));
+        return out;
+    }
+
+    void writeHeader() {
+        uint32_t dataBytes = static_cast<uint32_t>(frames_ * 2 * (bits_ / 8));
+        uint8_t header[44];
+        uint8_t* p = header;
+        auto tag = [&](const char* s) { for (int i = 0; i < 4; ++i) *p++ = static_cast<uint8_t>(s[i]); };
+        tag("RIFF");
+        p = little(36 + dataBytes, 4, p);
+        tag("WAVE");
+        tag("fmt ");
+        p = little(16, 4, p);
+        p = little((bits_ == 32) ? 3 : 1, 2, p);   // IEEE float or PCM
+        p = little(2, 2, p);
+        p = little(static_cast<uint32_t>(sampleRate_), 4, p);
+        p = little(static_cast<uint32_t>(sampleRate_ * 2 * (bits_ / 8)), 4, p);
+        p = little(2 * (bits_ / 8), 2, p);
+        p = little(static_cast<uint32_t>(bits_), 2, p);
+        tag("data");
+        little(dataBytes, 4, p);
+        std::fwrite(header, 1, sizeof(header), file_);
+    }
+
+    std::FILE* file_;
+    int bits_;
+    int sampleRate_;
+    int64_t frames_;
+    std::vector<uint8_t> bytes_;
+};